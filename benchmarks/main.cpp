@@ -3,6 +3,7 @@
 #include <pthread.h>
 #include <sys/time.h>
 #include <vector>
+#include "queue.h"
 
 using namespace std;
 
@@ -17,53 +18,6 @@ int Threads = 32;
 int Items = 1024*1024*1024 / (Threads/2);
 int Sum = 0;
 
-class Queue
-{
-  protected:
-    vector<int> buffer;
-    // vector<BOOL> isfree; // use this for a templated queue.
-    int size, mask;
-    int in, out;
-
-  public:
-    Queue(int s=64): size(s) //:size(RoundPowerOf2(s))
-    {
-        buffer = vector<int>(size, 0);
-        mask = size-1;
-        in = out = 0;
-    }
-
-    void push(int item)
-    {
-        assert(item);
-
-        int i;
-        do
-        {
-            i = in;
-            while (i-out == size) sched_yield(); // while full, wait for space
-        }
-        while (buffer[i & mask] || !__sync_bool_compare_and_swap(&in, i, i+1));
-
-        buffer[i & mask] = item;
-    }
-
-    int pop()
-    {
-        int o;
-        do
-        {
-            o = out;
-            while (o == in) sched_yield(); // while empty, wait for item
-        }
-        while (!buffer[o & mask] || !__sync_bool_compare_and_swap(&out, o, o+1));
-
-        int r = buffer[o &= mask];
-        buffer[o] = 0;
-        return r;
-    }
-};
-
 //Queue Q(64);          // default
 // Queue Q(1);        // stress (14x slower)
  Queue Q(1024); // benchmark (10,4% faster)
@@ -0,0 +1,53 @@
+// the queue benchmarked by main.cpp, ints only, 0 marks a free slot.
+// Also swept as "classic" by cpp/tests/queues.cc
+#pragma once
+#include <assert.h>
+#include <sched.h>
+#include <vector>
+
+class Queue
+{
+  protected:
+    std::vector<int> buffer;
+    // vector<BOOL> isfree; // use this for a templated queue.
+    int size, mask;
+    int in, out;
+
+  public:
+    Queue(int s=64): size(s) //:size(RoundPowerOf2(s))
+    {
+        buffer = std::vector<int>(size, 0);
+        mask = size-1;
+        in = out = 0;
+    }
+
+    void push(int item)
+    {
+        assert(item);
+
+        int i;
+        do
+        {
+            i = in;
+            while (i-out == size) sched_yield(); // while full, wait for space
+        }
+        while (buffer[i & mask] || !__sync_bool_compare_and_swap(&in, i, i+1));
+
+        buffer[i & mask] = item;
+    }
+
+    int pop()
+    {
+        int o;
+        do
+        {
+            o = out;
+            while (o == in) sched_yield(); // while empty, wait for item
+        }
+        while (!buffer[o & mask] || !__sync_bool_compare_and_swap(&out, o, o+1));
+
+        int r = buffer[o &= mask];
+        buffer[o] = 0;
+        return r;
+    }
+};
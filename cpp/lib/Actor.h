@@ -8,16 +8,16 @@ namespace uniq {
 inline void sleep() { sched_yield(); }
 inline void sleep(int ms) { usleep(ms*1000); }
 inline const int coreCount() { return thread::hardware_concurrency(); }
-#define WAIT(condition) while(!(condition)) { sleep(); }
 
 //===================================================================== Actor<T>
 template <typename T> struct Actor {
  protected:
-  bool _running = false;
+  atomic<bool> _running{false};
   uniq::voidfunction beat = [] {}; // voidfunction beat = []<typename... Args>(Args&&... args) { log(args...); };
 
   virtual void onempty() {}
   virtual void onfull() {}
+  virtual void ondrained() {} // closed and nothing left to pop, called once
 
  public:
   template <typename Func, typename... Args>
@@ -30,12 +30,19 @@ template <typename T> struct Actor {
   Actor() { start(); }
   ~Actor() { stop(); }
 
-  virtual void start() { _running = true; }
-  virtual void stop() { _running = false; }
-  inline bool running() { return _running; }
+  virtual void start() { _running.store(true, memory_order_release); }
+  virtual void stop() { _running.store(false, memory_order_release); }
+  inline bool running() { return _running.load(memory_order_acquire); }
 
-  virtual int push(const T& item, bool wait = true) { return 0; }
-  virtual int pop(T& item, bool wait = true) { return 0; }
+  // close() refuses new pushes but lets pops drain what is queued, stop() drops
+  // it. Queues that can drain override these three, the others just stop.
+  virtual void close() { stop(); }
+  virtual bool closed() { return !running(); }
+  virtual bool drained() { return closed() && empty(); }
+
+  // return the job id of the item, 0 when nothing was pushed/popped
+  virtual u64 push(const T& item, bool wait = true) { return 0; }
+  virtual u64 pop(T& item, bool wait = true) { return 0; }
 
   // virtual bool has(const T &item) { return 0; }
   // virtual bool T first(T &item) { return 0; }
@@ -3,6 +3,8 @@ namespace uniq {
 
 #define CST __ATOMIC_SEQ_CST
 
+const int CACHE_LINE = 64; // bytes, x86 and most arm64 cores
+
 template<class T>
 struct Atomic {
   T value;
@@ -0,0 +1,59 @@
+//==============================================================================
+// Cancellation • A flag tasks check to give up early, raised by its source
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+// A source may hang under a parent token: cancelling the parent cancels it,
+// not the other way. Checking is a relaxed load per level, cheap enough for
+// hot loops. The state is allocated once per source, never per task.
+struct CancellationState {
+  atomic<bool> raised{false};
+  shared_ptr<CancellationState> parent;
+};
+
+//=========================================================== CancellationToken
+class CancellationToken {
+  friend class CancellationSource;
+  shared_ptr<CancellationState> state; // none: never cancelled
+
+ public:
+  CancellationToken() {}
+  CancellationToken(shared_ptr<CancellationState> state) : state(move(state)) {}
+
+  inline bool cancelled() const {
+    for (CancellationState* s = state.get(); s; s = s->parent.get())
+      if (s->raised.load(memory_order_relaxed)) return true;
+    return false;
+  }
+
+  bool cancellable() const { return bool(state); }
+};
+
+//========================================================== CancellationSource
+class CancellationSource {
+  shared_ptr<CancellationState> state = make_shared<CancellationState>();
+
+ public:
+  CancellationSource(const CancellationToken& parent = CancellationToken()) { state->parent = parent.state; }
+
+  void cancel() { state->raised.store(true, memory_order_relaxed); }
+  bool cancelled() const { return token().cancelled(); }
+  CancellationToken token() const { return CancellationToken(state); }
+};
+
+// tests =======================================================================
+TEST(Cancellation) {
+  CancellationSource a;
+  CancellationSource b(a.token()); // b under a
+  CancellationToken none, t = b.token();
+  CHECK(!t.cancelled() && !none.cancelled() && !none.cancellable() && t.cancellable());
+  b.cancel();
+  CHECK(t.cancelled() && !a.cancelled());
+  CancellationSource c(a.token());
+  a.cancel();
+  CHECK(c.cancelled() && c.token().cancelled());
+}
+
+}// uniq • Released under GPL 3.0
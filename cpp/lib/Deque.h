@@ -0,0 +1,87 @@
+//==============================================================================
+// Deque • Chase-Lev work stealing deque, one owner and many thieves
+//==============================================================================
+#pragma once
+namespace uniq {
+
+// The owner pushes and takes at the bottom (LIFO, hot in its cache), thieves
+// steal from the top (FIFO, the oldest and usually biggest work). Only the
+// last item races, settled by a CAS on top. Items are pointers, so a thief
+// that loses the race has read nothing it may not own. The ring doubles when
+// full, the old rings stay until the deque dies since thieves may still look.
+// Lê, Pop, Cohen, Zappa Nardelli, Correct and Efficient Work-Stealing for
+// Weak Memory Models, PPoPP 2013.
+template <typename T> class Deque {
+  static_assert(is_pointer<T>::value, "a Deque holds pointers");
+
+  struct Ring {
+    i64 mask;
+    unique_ptr<atomic<T>[]> items;
+    Ring(i64 size) : mask(size - 1), items(new atomic<T>[size]) {}
+    inline T get(i64 i) { return items[i & mask].load(memory_order_relaxed); }
+    inline void put(i64 i, T x) { items[i & mask].store(x, memory_order_relaxed); }
+  };
+
+  alignas(CACHE_LINE) atomic<i64> top{0};    // thieves side
+  alignas(CACHE_LINE) atomic<i64> bottom{0}; // owner side
+  atomic<Ring*> ring;
+  vector<unique_ptr<Ring>> rings; // the current one and the outgrown, owner only
+
+ public:
+  Deque(int size = 64) {
+    i64 n = 2;
+    while (n < size) n *= 2;
+    rings.push_back(make_unique<Ring>(n));
+    ring.store(rings.back().get(), memory_order_relaxed);
+  }
+
+  void push(T x) { // owner only
+    i64 b = bottom.load(memory_order_relaxed), t = top.load(memory_order_acquire);
+    Ring* r = ring.load(memory_order_relaxed);
+    if (b - t > r->mask) r = grow(r, t, b);
+    r->put(b, x);
+    bottom.store(b + 1, memory_order_release); // publishes *x too, to a thief's acquire
+  }
+
+  T take() { // owner only, the newest item or nullptr
+    i64 b = bottom.load(memory_order_relaxed) - 1;
+    Ring* r = ring.load(memory_order_relaxed);
+    bottom.store(b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 t = top.load(memory_order_relaxed);
+    if (t > b) { // empty
+      bottom.store(b + 1, memory_order_relaxed);
+      return nullptr;
+    }
+    T x = r->get(b);
+    if (t == b) { // the last one, thieves may want it too
+      if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) x = nullptr;
+      bottom.store(b + 1, memory_order_relaxed);
+    }
+    return x;
+  }
+
+  T steal() { // any thread, the oldest item or nullptr when empty or lost a race
+    i64 t = top.load(memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    i64 b = bottom.load(memory_order_acquire);
+    if (t >= b) return nullptr;
+    T x = ring.load(memory_order_acquire)->get(t);
+    if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) return nullptr;
+    return x;
+  }
+
+  bool empty() { return bottom.load(memory_order_relaxed) <= top.load(memory_order_relaxed); }
+  int size() { return max<i64>(bottom.load(memory_order_relaxed) - top.load(memory_order_relaxed), 0); }
+
+ protected:
+  Ring* grow(Ring* r, i64 t, i64 b) {
+    rings.push_back(make_unique<Ring>(2 * (r->mask + 1)));
+    Ring* bigger = rings.back().get();
+    for (i64 i = t; i < b; i++) bigger->put(i, r->get(i));
+    ring.store(bigger, memory_order_release);
+    return bigger;
+  }
+};
+
+}// uniq • Released under GPL 3.0
@@ -0,0 +1,234 @@
+//==============================================================================
+// ElasticQueue • An unbounded lock free queue of linked, recycled segments
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+// Producers take a ticket in the tail segment with one fetch_add and link a
+// new segment when it runs out. Consumers claim ready slots from the head
+// segment with a CAS, like Queue. Each segment is used for one lap only, so
+// nobody can write behind a consumer that moved on. Segments are counted
+// (one reference for the chain plus one per thread inside) and go back to a
+// pool once the head passed them and the last thread left.
+// close() sets CLOSED on the tickets of the tail and seals its next, so no
+// producer can link a segment past it.
+template <typename T, int N = 128, typename Waiting = Park>
+class ElasticQueue : public Actor<T> {
+  struct alignas(CACHE_LINE) Slot {
+    atomic<bool> ready;
+    alignas(T) unsigned char data[sizeof(T)]; // T lives here from push to pop only
+    inline T& item() { return *launder(reinterpret_cast<T*>(data)); }
+  };
+
+  struct Segment {
+    alignas(CACHE_LINE) atomic<u64> in;  // tickets taken by producers, may pass N, and CLOSED
+    alignas(CACHE_LINE) atomic<u64> out; // slots claimed by consumers
+    alignas(CACHE_LINE) atomic<int> refs;
+    atomic<Segment*> next;
+    u64 base; // job id of the first slot, minus one
+    Slot slots[N];
+  };
+
+  alignas(CACHE_LINE) atomic<Segment*> head; // consumers side
+  alignas(CACHE_LINE) atomic<Segment*> tail; // producers side
+
+  Queue<Segment*> spare = Queue<Segment*>(32); // recycled segments, lock free
+  vector<Segment*> idle;                       // recycled when spare was full
+  vector<unique_ptr<Segment>> segments;        // every segment ever allocated
+  mutex m;                                     // on idle and segments
+  atomic<bool> shut{false};                    // close() is done
+  atomic<bool> signaled{false};                // ondrained() was called
+
+  static const u64 CLOSED = 1ULL << 63;
+  static inline Segment* sealed() { return reinterpret_cast<Segment*>(1); } // next of the last, once closed
+
+  // the next segment, nullptr at the end, sealed or not
+  static inline Segment* follow(Segment* s) {
+    Segment* n = s->next.load(memory_order_acquire);
+    return n == sealed() ? nullptr : n;
+  }
+
+  static inline u64 tickets(Segment* s) { return min<u64>(s->in.load(memory_order_acquire) & ~CLOSED, N); }
+
+ public:
+  Waiting notEmpty; // consumers wait for items, producers never wait
+
+  ElasticQueue() { head = tail = segment(0); }
+
+  ~ElasticQueue() { // destroy the items nobody popped
+    for (Segment* s = head; s; s = follow(s))
+      for (u64 o = s->out; o < tickets(s); o++)
+        if (s->slots[o].ready) s->slots[o].item().~T();
+  }
+
+  void stop() override {
+    Actor<T>::stop();
+    notEmpty.notify(INT_MAX);
+  }
+
+  // pushes fail from now on, pops go on until the items pushed before run out.
+  // A segment linked meanwhile moves the tail on, then it is closed too
+  void close() override {
+    for (bool done = false; !done;) {
+      Segment *s = acquire(tail), *n = nullptr;
+      s->in.fetch_or(CLOSED, memory_order_acq_rel);
+      done = s->next.compare_exchange_strong(n, sealed(), memory_order_acq_rel) || n == sealed();
+      Segment* e = s;
+      if (!done) tail.compare_exchange_strong(e, n);
+      release(s);
+    }
+    shut.store(true, memory_order_release); // the tail is the last segment now
+    notEmpty.notify(INT_MAX);
+    if (drained()) signal();
+  }
+
+  bool closed() override { return shut.load(memory_order_acquire); }
+
+  // closed, and every ticket taken was popped
+  bool drained() override { return closed() && !size(); }
+
+  // push and pop return the job id of the item, or 0 when nothing was queued
+  u64 push(const T& item, bool wait = true) {
+    if constexpr (is_copy_constructible<T>::value) return place(item);
+    return 0;
+  }
+  u64 push(T&& item, bool wait = true) { return place(move(item)); }
+
+  template <typename... Args>
+  u64 emplace(Args&&... args) { return place(forward<Args>(args)...); }
+
+  u64 pop(T& item, bool wait = true) {
+    for (;;) {
+      Segment* s = acquire(head);
+      u64 o = s->out.load(memory_order_relaxed);
+      if (o >= N) { // used up, move the head to the next segment
+        Segment *next = follow(s), *h = s, *t = s;
+        if (next && head.compare_exchange_strong(h, next)) {
+          tail.compare_exchange_strong(t, next); // never leave the tail behind the head
+          release(s); // the chain reference
+        }
+        release(s);
+        if (next) continue;
+      } else if (s->slots[o].ready.load(memory_order_acquire)) {
+        if (s->out.compare_exchange_weak(o, o + 1, memory_order_relaxed)) {
+          Slot& slot = s->slots[o];
+          item = move(slot.item());
+          slot.item().~T();
+          u64 id = s->base + o + 1;
+          release(s);
+          return id;
+        }
+        release(s);
+        continue;
+      } else release(s); // empty, or its producer is still writing
+
+      this->onempty();
+      if (drained()) { signal(); return 0; }
+      if (!wait || !this->running()) return 0;
+      notEmpty.wait([&]{ return !empty() || !this->running() || drained(); });
+    }
+  }
+
+  bool full() override { return false; }
+
+  bool empty() override {
+    Segment* s = acquire(head);
+    u64 o = s->out.load(memory_order_relaxed);
+    bool r = o < N ? !s->slots[o].ready.load(memory_order_acquire) : !follow(s);
+    release(s);
+    return r;
+  }
+
+  int size() {
+    Segment *h = acquire(head), *t = acquire(tail);
+    i64 r = (t->base + tickets(t)) - (h->base + min<u64>(h->out, N));
+    release(t);
+    release(h);
+    return max<i64>(r, 0);
+  }
+
+ protected:
+  template <typename... Args>
+  u64 place(Args&&... args) {
+    if (!this->running()) return 0;
+    for (;;) {
+      Segment* s = acquire(tail);
+      u64 t = s->in.fetch_add(1, memory_order_relaxed);
+      if (t & CLOSED) { // give the ticket back, drained() counts them
+        s->in.fetch_sub(1, memory_order_relaxed);
+        release(s);
+        notEmpty.notify(INT_MAX);
+        return 0;
+      }
+      if (t < N) {
+        Slot& slot = s->slots[t];
+        new (slot.data) T(forward<Args>(args)...);
+        slot.ready.store(true, memory_order_release);
+        u64 id = s->base + t + 1;
+        release(s);
+        notEmpty.notify();
+        return id;
+      }
+
+      Segment* next = s->next.load(memory_order_acquire);
+      if (!next) { // link a new segment, the loser recycles its own
+        Segment* n = segment(s->base + N);
+        if (s->next.compare_exchange_strong(next, n)) next = n;
+        else release(n);
+      }
+      if (next == sealed()) { // closed while we were at it
+        release(s);
+        return 0;
+      }
+      Segment* e = s;
+      tail.compare_exchange_strong(e, next);
+      release(s);
+    }
+  }
+
+  // enter the segment at end, if it is still there once we hold it
+  Segment* acquire(atomic<Segment*>& end) {
+    for (;;) {
+      Segment* s = end.load(memory_order_acquire);
+      int r = s->refs.load(memory_order_relaxed);
+      while (r > 0 && !s->refs.compare_exchange_weak(r, r + 1, memory_order_acquire));
+      if (r <= 0) continue; // recycled under our feet
+      if (end.load(memory_order_acquire) == s) return s;
+      release(s);
+    }
+  }
+
+  inline void release(Segment* s) {
+    if (s->refs.fetch_sub(1, memory_order_acq_rel) == 1) recycle(s);
+  }
+
+  void signal() { if (!signaled.exchange(true)) this->ondrained(); }
+
+  // past a burst spare overflows into idle, so no segment is ever lost
+  void recycle(Segment* s) {
+    if (spare.push(s, false)) return;
+    lock_guard<mutex> lock(m);
+    idle.push_back(s);
+  }
+
+  Segment* segment(u64 base) {
+    Segment* s;
+    if (!spare.pop(s, false)) {
+      lock_guard<mutex> lock(m);
+      if (idle.size()) s = idle.back(), idle.pop_back();
+      else {
+        segments.push_back(make_unique<Segment>());
+        s = segments.back().get();
+      }
+    }
+    s->in = s->out = 0;
+    s->next = nullptr;
+    s->base = base;
+    for (auto& slot : s->slots) slot.ready.store(false, memory_order_relaxed);
+    s->refs.store(1, memory_order_release); // the chain reference, published last
+    return s;
+  }
+};
+
+}// uniq • Released under GPL 3.0
@@ -0,0 +1,146 @@
+//==============================================================================
+// Executor • Named ThreadPools kept apart: cpu, io, latency and your own
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+// Blocking work (disk, sockets, sleeps) on the compute pool holds its workers
+// doing nothing. Executors split them: executor("io") for what blocks, with
+// more threads than cores, executor("cpu") for compute, executor("latency")
+// for the few tasks that must not queue behind bulk work. A task hops from
+// one to another with then(executor("cpu"), f) on a Future, or waits for
+// hop(executor("io"), f) while its worker keeps running its own pool's tasks.
+// pool() stays the default pool, apart from all of them.
+struct ExecutorSpec {
+  int threads = coreCount();
+  Placement placement = UNPINNED;
+  int lane = 64;                 // capacity of each injection priority lane
+  Saturation saturation = BLOCK; // when a lane is full
+  Priority priority = NORMAL;    // of the tasks run() without one
+  int nice = 0;                  // of the threads, see ThreadPool::nice
+};
+
+//==================================================================== Executor
+// Holds its pool rather than being one: workers start in the pool's
+// constructor and must not see an object still being built around it
+struct Executor {
+  string name;
+  ExecutorSpec spec;
+  ThreadPool pool;
+
+  Executor(const string& name, ExecutorSpec spec)
+    : name(name), spec(spec), pool(max(1, spec.threads), spec.placement, spec.lane, spec.nice) {
+    pool.saturation = spec.saturation;
+  }
+
+  ~Executor() { // workers must be gone before the pool is
+    pool.close();
+    pool.join();
+  }
+
+  operator ThreadPool&() { return pool; } // for then(), hop(), TaskGroup, parallel_for...
+
+  template <typename Func, typename... Args>
+  inline u64 run(Func&& f, Args&&... args) {
+    return pool.run(spec.priority, forward<Func>(f), forward<Args>(args)...);
+  }
+
+  template <typename Func, typename... Args>
+  inline u64 run(Priority p, Func&& f, Args&&... args) {
+    return pool.run(p, forward<Func>(f), forward<Args>(args)...);
+  }
+
+  template <typename Func, typename... Args>
+  auto async(Func&& f, Args&&... args) {
+    return pool.async(forward<Func>(f), forward<Args>(args)...);
+  }
+};
+
+// the specs known by name, the executor is made on its first use
+inline map<string, ExecutorSpec>& executorSpecs() {
+  static map<string, ExecutorSpec> specs = [] {
+    map<string, ExecutorSpec> m;
+    ExecutorSpec io, latency;
+    io.threads = 4 * coreCount(), io.lane = 256;
+    latency.threads = max(1, coreCount() / 4), latency.priority = URGENT, latency.nice = -5;
+    m["cpu"] = ExecutorSpec();
+    m["io"] = io;
+    m["latency"] = latency;
+    return m;
+  }();
+  return specs;
+}
+
+inline mutex& executorLock() {
+  static mutex m;
+  return m;
+}
+
+//==================================================================== executor
+inline Executor& executor(const string& name) {
+  static map<string, unique_ptr<Executor>> made;
+  lock_guard<mutex> hold(executorLock());
+  auto& e = made[name];
+  if (!e) {
+    auto& specs = executorSpecs();
+    if (!specs.count(name)) {
+      made.erase(name);
+      throw out_of_range(sstr("no executor named ", name));
+    }
+    e = make_unique<Executor>(name, specs[name]);
+  }
+  return *e;
+}
+
+// defines or redefines name, before its first use
+inline void defineExecutor(const string& name, ExecutorSpec spec) {
+  lock_guard<mutex> hold(executorLock());
+  executorSpecs()[name] = spec;
+}
+
+//========================================================================= hop
+// f(args...) on another executor, waited for. The caller's worker goes on
+// running its own pool's tasks meanwhile, see Future::wait()
+template <typename Func, typename... Args>
+auto hop(ThreadPool& to, Func&& f, Args&&... args) {
+  if (ThreadPool::owner == &to) return invoke(forward<Func>(f), forward<Args>(args)...); // already there
+  return to.async(forward<Func>(f), forward<Args>(args)...).get();
+}
+
+// tests =======================================================================
+TEST(Executor) {
+  ExecutorSpec slow;
+  slow.threads = 2, slow.nice = 5;
+  defineExecutor("test-io", slow);
+  ExecutorSpec fast;
+  fast.threads = 2, fast.priority = HIGH;
+  defineExecutor("test-cpu", fast);
+  Executor &io = executor("test-io"), &cpu = executor("test-cpu");
+  CHECK(&executor("test-io") == &io && io.pool.workers.size() == 2);
+  bool unknown = false;
+  try { executor("nonexistent"); } catch (out_of_range&) { unknown = true; }
+  CHECK(unknown);
+
+  atomic<bool> go(false); // io stuck on slow reads, compute still flows
+  for (int i = 0; i < 2; i++) io.run([&] { while (!go) usleep(1000); });
+  atomic<int> computed(0);
+  for (int i = 0; i < 100; i++) cpu.run([&] { computed++; });
+  for (int i = 0; i < 2000 && computed < 100; i++) usleep(1000);
+  CHECK(computed == 100);
+  go = true;
+
+  // cpu => io => cpu, each step on its own executor. The futures are waited
+  // for without get(), which would run them here, helping
+  auto on = [](Executor& e) { return ThreadPool::owner == &e.pool; };
+  auto ready = [](auto& f) { while (!f.ready()) usleep(1000); return true; };
+  Future<bool> f = cpu.async([&] {
+    int nice = hop(io, [&] { return on(io) ? getpriority(PRIO_PROCESS, syscall(SYS_gettid)) : -1; });
+    return on(cpu) && nice == 5;
+  });
+  CHECK(ready(f) && f.get());
+  Future<bool> g = io.async([&] { return on(io); }).then(cpu, [&](bool was) { return was && on(cpu); });
+  CHECK(ready(g) && g.get());
+}
+
+}// uniq • Released under GPL 3.0
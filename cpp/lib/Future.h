@@ -0,0 +1,202 @@
+//==============================================================================
+// Future • The result of a task run on a ThreadPool, no std::promise needed
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+//================================================================= FutureState
+// What a task and its Future share: the result, inline, and a then() to run
+// once it is there. It comes from TaskMemory and the last of both frees it.
+template <typename R> struct FutureState : Parking {
+  static_assert(!is_reference<R>::value, "a Future holds values, not references");
+  typedef typename conditional<is_void<R>::value, char, R>::type Value;
+  static const u32 READY = 1, CHAINED = 2;
+
+  atomic<u32> status{0};
+  atomic<int> refs{2}; // the Future and the task
+  ThreadPool* pool;         // the task's
+  ThreadPool* to = nullptr; // where next runs, pool when none
+  alignas(Value) unsigned char data[sizeof(Value)]; // the result lives here once READY
+  bool kept = false;                                 // and no error
+  exception_ptr error;
+  Task next; // the then() continuation, run once READY
+
+  FutureState(ThreadPool* pool) : pool(pool) {}
+  ~FutureState() { if (kept) value().~Value(); }
+
+  inline Value& value() { return *launder(reinterpret_cast<Value*>(data)); }
+
+  static FutureState* make(ThreadPool* pool) {
+    static_assert(alignof(FutureState) <= CACHE_LINE, "TaskMemory blocks are only cache line aligned");
+    return new (TaskMemory::get(sizeof(FutureState))) FutureState(pool);
+  }
+
+  void release() {
+    if (refs.fetch_sub(1, memory_order_acq_rel) != 1) return;
+    this->~FutureState();
+    TaskMemory::put(this, sizeof(FutureState));
+  }
+
+  inline bool ready() { return status.load(memory_order_acquire) & READY; }
+
+  // keeps what f returns or throws, then wakes the waiters and the continuation
+  template <typename F> void fulfil(F&& f) {
+    try {
+      if constexpr (is_void<R>::value) f();
+      else new (data) Value(f());
+      kept = !is_void<R>::value;
+    } catch (...) {
+      error = current_exception();
+    }
+    if (status.fetch_or(READY, memory_order_acq_rel) & CHAINED) schedule();
+    unpark(INT_MAX);
+    release();
+  }
+
+  // whoever comes second, chain() or fulfil(), schedules the continuation
+  void chain(Task&& t, ThreadPool* on) {
+    next = move(t);
+    to = on;
+    if (status.fetch_or(CHAINED, memory_order_acq_rel) & READY) schedule();
+  }
+
+ protected:
+  void schedule() {
+    ThreadPool* p = to ? to : pool;
+    if (p->closed()) return next(); // nobody would pop it
+    p->run(move(next));
+  }
+};
+
+//===================================================================== Promise
+// The task's end of a FutureState. A task dropped before it ran, as when the
+// pool closed, breaks its promise so get() throws instead of waiting forever.
+template <typename R> struct Promise {
+  FutureState<R>* state;
+
+  Promise(FutureState<R>* state) : state(state) {}
+  Promise(Promise&& p) noexcept : state(p.state) { p.state = nullptr; }
+  Promise(const Promise&) = delete;
+  ~Promise() { if (state) state->fulfil([]() -> R { throw runtime_error("broken promise, the task never ran"); }); }
+
+  template <typename F> void operator()(F&& f) {
+    FutureState<R>* s = state;
+    state = nullptr;
+    s->fulfil(f);
+  }
+};
+
+//====================================================================== Future
+// Moves, never copies. get() returns the result once, or rethrows what the
+// task threw; while waiting it runs pool tasks, so a worker waiting on a
+// task it spawned runs that task itself. A worker helps its own pool, not the
+// task's: one waiting on an IO executor goes on computing, not reading.
+template <typename R> class Future {
+  FutureState<R>* state = nullptr;
+
+  template <typename F, typename T> struct Then { typedef invoke_result_t<F, T> type; };
+  template <typename F> struct Then<F, void> { typedef invoke_result_t<F> type; };
+
+ public:
+  Future() {}
+  explicit Future(FutureState<R>* state) : state(state) {}
+  Future(Future&& f) noexcept : state(f.state) { f.state = nullptr; }
+  Future& operator=(Future&& f) noexcept { swap(state, f.state); return *this; }
+  ~Future() { reset(); }
+
+  bool valid() { return state; }
+  bool ready() { return state && state->ready(); }
+
+  void wait() {
+    ThreadPool& pool = ThreadPool::owner ? *ThreadPool::owner : *state->pool;
+    auto ready = [&] { return state->ready(); };
+    while (!ready())
+      if (!pool.help()) state->park(ready, CpuTime() + 0.001); // new work may come meanwhile
+  }
+
+  R get() {
+    wait();
+    if (exception_ptr e = state->error) {
+      reset();
+      rethrow_exception(e);
+    }
+    if constexpr (is_void<R>::value) reset();
+    else {
+      R r = move(state->value());
+      reset();
+      return r;
+    }
+  }
+
+  // f(result), or f() for a Future<void>, runs on the pool once this one is
+  // ready, and returns the Future of f. Errors skip f and pass along.
+  template <typename F> auto then(F&& f) { return then(*state->pool, forward<F>(f)); }
+
+  // the same, with f run on another pool: hops from one executor to the next
+  template <typename F> auto then(ThreadPool& on, F&& f) {
+    typedef typename Then<typename decay<F>::type&, R>::type U;
+    FutureState<U>* s = FutureState<U>::make(&on);
+    FutureState<R>* mine = state;
+    mine->chain(Task([before = move(*this), p = Promise<U>(s), f = forward<F>(f)]() mutable {
+      p([&]() -> U {
+        if (before.state->error) rethrow_exception(before.state->error);
+        if constexpr (is_void<R>::value) return f();
+        else return f(move(before.state->value()));
+      });
+    }), &on);
+    return Future<U>(s);
+  }
+
+  void reset() {
+    if (state) state->release();
+    state = nullptr;
+  }
+};
+
+// ======================================================== ThreadPool::async()
+template <typename Func, typename... Args>
+auto ThreadPool::async(Func &&f, Args &&...args) {
+  typedef invoke_result_t<typename decay<Func>::type&, typename decay<Args>::type&...> R;
+  FutureState<R>* s = FutureState<R>::make(this);
+  run([p = Promise<R>(s), f = forward<Func>(f), a = make_tuple(forward<Args>(args)...)]() mutable {
+    p([&]() -> R { return apply(f, a); });
+  });
+  return Future<R>(s);
+}
+
+template <typename Func, typename... Args>
+inline auto async(Func&& f, Args&&... args) {
+  return pool().async(forward<Func>(f), forward<Args>(args)...);
+}
+
+// tests =======================================================================
+TEST(Future) {
+  ThreadPool p(2);
+  auto sum = [](int a, int b) { return a + b; };
+  Future<int> f = p.async(sum, 20, 22);
+  CHECK(f.get() == 42 && !f.valid());
+
+  auto twice = p.async(sum, 1, 2).then([](int x) { return 2 * x; }).then([](int x) { return to_string(x); });
+  CHECK(twice.get() == "6");
+
+  auto fails = p.async([]() -> int { throw runtime_error("no"); }).then([](int x) { return x; });
+  bool caught = false;
+  try { fails.get(); } catch (runtime_error&) { caught = true; }
+  CHECK(caught);
+
+  function<u64(int)> fib = [&](int n) -> u64 { // waits inside tasks, helping
+    if (n < 2) return n;
+    auto a = p.async(fib, n - 1);
+    return fib(n - 2) + a.get();
+  };
+  CHECK(p.async(fib, 20).get() == 6765);
+
+  p.close(); // the dropped task breaks its promise
+  caught = false;
+  try { p.async(sum, 1, 1).then([](int x) { return x; }).get(); } catch (runtime_error&) { caught = true; }
+  CHECK(caught);
+  p.join();
+}
+
+}// uniq • Released under GPL 3.0
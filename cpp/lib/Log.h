@@ -4,10 +4,10 @@
 #pragma once
 namespace uniq {
 //========================================================================== Log
-class Log : public uniq::OpenQueue<string>, public Named{ 
+class Log : public uniq::ElasticQueue<string>, public Named{ 
 public:
   bool hasColors = 1;
-  OpenQueue<string> Q; // Queue of strings waiting to be flushed
+  ElasticQueue<string> Q; // Queue of strings waiting to be flushed
 
   Log(string name="console") : Named(name){ };
 
@@ -1,40 +1,106 @@
-// OpenQueue - A Thread-safe Queue using mutexes and condition variables.
+// OpenQueue - A Thread-safe Queue using mutexes and a wait strategy.
 // Used for speed comparison. https://stackoverflow.com/a/16075550/9464885
 #pragma once
 #include "uniq.h"
 namespace uniq {
 
-template <typename T> class OpenQueue : public Actor<T> {
+template <typename T, typename Waiting = Park> class OpenQueue : public Actor<T> {
   queue<T> q;
   mutable mutex m;
-  condition_variable notEmpty;
-  atomic<int> in, out;
+  atomic<u64> in, out;
+  atomic<bool> shut{false}; // set by close(), under m
+  bool signaled = false;    // ondrained() was called, under m
   int maxsize=0;
  public:
-  
-  OpenQueue(int maxsize = 0) 
+  Waiting notFull, notEmpty; // producers wait for room, consumers for items
+
+  OpenQueue(int maxsize = 0)
     : maxsize(maxsize), Actor<T>() { out = in = 1; }
 
-  int push(const T item, bool wait=true) {
-    if(maxsize) WAIT(q.size() < maxsize);
-    lock_guard<mutex> lock(m);
-    q.push(item);
-    notEmpty.notify_one();
-    return in++;
+  u64 push(const T& item, bool wait=true) { // virtual, so guard move-only items
+    if constexpr (is_copy_constructible<T>::value) return tryPushUntil(item, wait ? FOREVER : 0);
+    return 0;
+  }
+  u64 push(T&& item, bool wait=true) { return tryPushUntil(move(item), wait ? FOREVER : 0); }
+  u64 pop(T &item, bool wait=true) { return tryPopUntil(item, wait ? FOREVER : 0); }
+
+  // as push/pop, but give up once the deadline, a CpuTime(), has passed.
+  // 0 tells it timed out, or that the queue stopped or drained
+  template <typename Item>
+  u64 tryPushFor(Item&& item, Time timeout) { return tryPushUntil(forward<Item>(item), CpuTime() + timeout); }
+  u64 tryPopFor(T &item, Time timeout) { return tryPopUntil(item, CpuTime() + timeout); }
+
+  // room is checked under the lock, so maxsize holds with many producers
+  template <typename Item>
+  u64 tryPushUntil(Item&& item, Time deadline) {
+    u64 i;
+    for (;;) {
+      bool wait = !expired(deadline);
+      unique_lock<mutex> lock(m);
+      if (shut) return 0;
+      if (!maxsize || !full()) {
+        q.push(forward<Item>(item));
+        i = in++;
+        break;
+      }
+      lock.unlock();
+      if (!wait || !this->running()) return 0;
+      if (!notFull.wait([&]{ return !full() || !this->running() || closed(); }, deadline)) return 0;
+    }
+    notEmpty.notify();
+    return i;
+  }
+
+  u64 tryPopUntil(T &item, Time deadline) {
+    u64 o;
+    for (;;) {
+      bool wait = !expired(deadline);
+      if (wait && !notEmpty.wait([&]{ return !empty() || !this->running() || closed(); }, deadline)) return 0;
+      unique_lock<mutex> lock(m);
+      if (!q.empty()) {
+        item = move(q.front());
+        q.pop();
+        o = out++;
+        break;
+      }
+      if (shut) {
+        bool first = !signaled;
+        signaled = true;
+        lock.unlock();
+        if (first) this->ondrained();
+        return 0;
+      }
+      if (!wait || !this->running()) return 0;
+    }
+    notFull.notify();
+    return o;
   }
 
-  int pop(T &item, bool wait=true) {
-    unique_lock<mutex> lock(m);
-    notEmpty.wait(lock, [&]{ return !q.empty(); } );
-    item = q.front();
-    q.pop();
-    return out++; 
+  void start() override {
+    { lock_guard<mutex> lock(m); shut = signaled = false; }
+    Actor<T>::start();
   }
 
-  inline bool full() { return (in-out) >= maxsize; }
-  inline bool empty() { return q.empty(); }
+  void stop() override {
+    Actor<T>::stop();
+    notFull.notify(INT_MAX);
+    notEmpty.notify(INT_MAX);
+  }
+
+  // pushes fail from now on, pops go on until the queue is empty
+  void close() override {
+    { lock_guard<mutex> lock(m); shut = true; }
+    notFull.notify(INT_MAX);
+    notEmpty.notify(INT_MAX);
+  }
+
+  bool closed() override { return shut; }
+  bool drained() override { return shut && empty(); }
+
+  inline bool full() { return (in-out) >= u64(maxsize); }
+  inline bool empty() { return in == out; }
   inline int size() { return in-out; }
-  inline int done() { return out-1; }
+  inline u64 done() { return out-1; }
 };
 
 }// uniq • Released under GPL 3.0
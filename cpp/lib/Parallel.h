@@ -0,0 +1,127 @@
+//==============================================================================
+// Parallel • parallel_for and parallel_reduce on a ThreadPool
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+//======================================================================= Range
+// [begin, end) run serially grain indexes at a time. grain 0 picks one
+template <typename Index> struct Range {
+  Index begin, end, grain;
+  Range(Index begin, Index end, Index grain = 0) : begin(begin), end(end), grain(grain) {}
+  Index size() const { return end > begin ? end - begin : 0; }
+};
+
+//================================================================== Reduction
+// Lazy binary splitting: a task walks its range a grain at a time and, only
+// when ThreadPool::hungry() says a peer may be idle, gives the upper half
+// away as a new task. Busy pools split little, idle ones split until every
+// worker has a piece. Each task reduces its chunks into a local value and
+// combines it into the total once, at its end. done(value) cancels the group,
+// so the tasks not started yet end as they are popped, and so does a cancel
+// of the token given to parallel_reduce.
+template <typename Index, typename T, typename Map, typename Combine, typename Done>
+struct Reduction {
+  ThreadPool& pool;
+  Index grain;
+  Map& map;
+  Combine& combine;
+  Done& done;
+  T identity, total;
+  mutex lock; // on total
+  TaskGroup group; // last, so it is gone before what its tasks use
+
+  Reduction(ThreadPool& pool, Index grain, T init, Map& map, Combine& combine, Done& done, const CancellationToken& token)
+    : pool(pool), grain(grain), map(map), combine(combine), done(done), identity(init), total(init), group(pool, token) {}
+
+  void operator()(Index lo, Index hi) {
+    T acc = identity;
+    while (lo < hi && !group.cancelled()) {
+      if (hi - lo > grain && pool.hungry()) {
+        Index mid = lo + (hi - lo) / 2;
+        group.run([this, mid, hi] { (*this)(mid, hi); });
+        hi = mid;
+        continue;
+      }
+      Index e = hi - lo > grain ? lo + grain : hi;
+      acc = combine(move(acc), map(Range<Index>(lo, e, grain)));
+      if (done(acc)) group.cancel();
+      lo = e;
+    }
+    lock_guard<mutex> hold(lock);
+    total = combine(move(total), move(acc));
+  }
+
+  T run(Index begin, Index end) {
+    (*this)(begin, end);
+    group.wait();
+    return move(total);
+  }
+};
+
+//============================================================= parallel_reduce
+// combine(map(chunk), ...) over the chunks of r, in no particular order, so
+// combine must be associative and commutative and init its identity. Stops
+// early once done(partial) is true for any partial result, as a found item,
+// or once token is cancelled.
+template <typename Index, typename T, typename Map, typename Combine, typename Done>
+T parallel_reduce(Range<Index> r, T init, Map map, Combine combine, Done done, ThreadPool& pool = uniq::pool(),
+                  const CancellationToken& token = CancellationToken()) {
+  if (!r.size()) return init;
+  Index workers = max<Index>(1, pool.workers.size());
+  Index grain = r.grain ? r.grain : max<Index>(1, r.size() / (64 * workers));
+  return Reduction<Index, T, Map, Combine, Done>(pool, grain, move(init), map, combine, done, token).run(r.begin, r.end);
+}
+
+template <typename Index, typename T, typename Map, typename Combine>
+T parallel_reduce(Range<Index> r, T init, Map map, Combine combine) {
+  auto never = [](const T&) { return false; };
+  return parallel_reduce(r, move(init), map, combine, never);
+}
+
+//================================================================ parallel_for
+// f(i) for every i in [begin, end). When f returns a bool, true stops the
+// loop: the indexes not reached yet are skipped. Returns whether it stopped.
+template <typename Index, typename F>
+bool parallel_for(Index begin, Index end, F f, Index grain = 0, ThreadPool& pool = uniq::pool()) {
+  auto chunk = [&](Range<Index> r) {
+    for (Index i = r.begin; i < r.end; i++)
+      if constexpr (is_same<decltype(f(i)), bool>::value) { if (f(i)) return true; }
+      else f(i);
+    return false;
+  };
+  auto either = [](bool a, bool b) { return a || b; };
+  auto found = [](bool b) { return b; };
+  return parallel_reduce(Range<Index>(begin, end, grain), false, chunk, either, found, pool);
+}
+
+// tests =======================================================================
+TEST(Parallel) {
+  ThreadPool p(2);
+  vector<int> v(10'000, 0);
+  parallel_for(0, int(v.size()), [&](int i) { v[i] = i; }, 0, p);
+  bool all = true;
+  for (int i = 0; i < int(v.size()); i++) all = all && v[i] == i;
+  CHECK(all);
+
+  long sum = parallel_reduce(Range<long>(1, 100'001), 0L,
+    [](Range<long> r) { long s = 0; for (long i = r.begin; i < r.end; i++) s += i; return s; },
+    [](long a, long b) { return a + b; }, [](long) { return false; }, p);
+  CHECK(sum == 5'000'050'000L);
+
+  atomic<long> visited(0); // stops soon after 777 is found
+  bool found = parallel_for(0L, 10'000'000L, [&](long i) { visited++; return i == 777; }, 100L, p);
+  CHECK(found && visited < 10'000'000);
+
+  u64 n = 1'000'003ULL * 1'000'033ULL, limit = sqrt(n); // the smallest divisor
+  u64 d = parallel_reduce(Range<u64>(2, limit + 1), n,
+    [&](Range<u64> r) { for (u64 i = r.begin; i < r.end; i++) if (!(n % i)) return i; return n; },
+    [](u64 a, u64 b) { return min(a, b); }, [&](u64 x) { return x < n; }, p);
+  CHECK(d == 1'000'003ULL);
+
+  p.close();
+  p.join();
+}
+
+}// uniq • Released under GPL 3.0
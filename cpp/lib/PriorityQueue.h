@@ -0,0 +1,145 @@
+//==============================================================================
+// PriorityQueue • Lock free lanes of Queue, picked by a consumer side policy
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+enum Selection {
+  STRICT,   // always the most urgent non empty lane
+  WEIGHTED, // round robin, lane l gets weights[l] turns per round
+  AGING     // strict, but a lane passed over maxAge times is served next
+};
+
+// Lane 0 is the most urgent. push(item) goes to the middle lane, pushAt(level,
+// item) to any. The policy state (Turns) belongs to each consumer of each
+// queue, so picking a lane costs no shared writes: a consumer may keep its
+// own and pass it to pop(), else the thread keeps one for the last queue it
+// popped from.
+template <typename T, int Levels = 3, typename Waiting = Adaptive>
+struct PriorityQueue : Actor<T> {
+  typedef Queue<T, MPMC, Waiting> Lane;
+  unique_ptr<Lane> lanes[Levels];
+
+  Selection selection = STRICT;
+  int weights[Levels]; // WEIGHTED turns per lane, 2^(Levels-1-l) by default
+  u32 maxAge = 64;     // AGING skips before a lane jumps ahead
+
+  Waiting notEmpty; // consumers wait for any lane
+
+  struct Turns {
+    u32 turn = 0;         // WEIGHTED position in the round
+    u32 age[Levels] = {}; // AGING skips per lane
+  };
+
+  PriorityQueue(int size = 1) {
+    for (int l = 0; l < Levels; l++) {
+      lanes[l] = make_unique<Lane>(size);
+      weights[l] = 1 << (Levels - 1 - l);
+    }
+  }
+
+  void start() override {
+    Actor<T>::start();
+    for (auto& l : lanes) l->start();
+  }
+
+  void stop() override {
+    Actor<T>::stop();
+    for (auto& l : lanes) l->stop();
+    notEmpty.notify(INT_MAX);
+  }
+
+  void close() override { // every lane drains, urgent first as always
+    for (auto& l : lanes) l->close();
+    notEmpty.notify(INT_MAX);
+  }
+
+  bool closed() override { return lanes[0]->closed(); }
+
+  bool drained() override {
+    for (auto& l : lanes) if (!l->drained()) return false;
+    return true;
+  }
+
+  // ids are unique across lanes: ((lane id-1) * Levels + level) + 1
+  u64 push(const T& item, bool wait = true) { return pushAt(Levels / 2, item, wait); }
+  u64 push(T&& item, bool wait = true) { return pushAt(Levels / 2, move(item), wait); }
+
+  template <typename Item>
+  u64 pushAt(int level, Item&& item, bool wait = true) {
+    level = max(0, min(level, Levels - 1));
+    u64 id = lanes[level]->push(forward<Item>(item), wait);
+    if (!id) return 0;
+    notEmpty.notify();
+    return (id - 1) * Levels + level + 1;
+  }
+
+  u64 pop(T& item, bool wait = true) { return pop(item, wait, mine()); }
+
+  u64 pop(T& item, bool wait, Turns& turns) {
+    for (;;) {
+      if (!this->running()) return 0;
+      int first = pick(turns);
+      for (int i = 0; i < Levels; i++) {
+        int l = (first + i) % Levels;
+        if (u64 id = lanes[l]->pop(item, false)) {
+          served(turns, l);
+          return (id - 1) * Levels + l + 1;
+        }
+      }
+      if (drained()) return 0;
+      this->onempty();
+      if (!wait) return 0;
+      notEmpty.wait([&]{ return !empty() || !this->running() || drained(); });
+    }
+  }
+
+  bool full() override { return lanes[Levels / 2]->full(); }
+  bool empty() override {
+    for (auto& l : lanes) if (!l->empty()) return false;
+    return true;
+  }
+
+  int size() { int r = 0; for (auto& l : lanes) r += l->size(); return r; }
+  u64 counter() { u64 r = 0; for (auto& l : lanes) r += l->counter(); return r; }
+
+  WaitStats waitStats() {
+    WaitStats r = notEmpty.stats;
+    for (auto& l : lanes) r += l->waitStats();
+    return r;
+  }
+
+  QueueStats stats() { QueueStats r; for (auto& l : lanes) r += l->stats(); return r; }
+
+ protected:
+  Turns& mine() { // the calling thread's, reset when it moves to another queue
+    static thread_local const PriorityQueue* of = nullptr;
+    static thread_local Turns turns;
+    if (of != this) of = this, turns = Turns();
+    return turns;
+  }
+
+  int pick(Turns& turns) { // the lane to try first
+    if (selection == WEIGHTED) {
+      int round = 0;
+      for (int w : weights) round += max(w, 1);
+      int t = turns.turn++ % round;
+      for (int l = 0; l < Levels; l++)
+        if ((t -= max(weights[l], 1)) < 0) return l;
+    } else if (selection == AGING) {
+      for (int l = Levels - 1; l > 0; l--)
+        if (turns.age[l] >= maxAge && !lanes[l]->empty()) return l;
+    }
+    return 0;
+  }
+
+  void served(Turns& turns, int lane) {
+    if (selection != AGING) return;
+    turns.age[lane] = 0;
+    for (int l = lane + 1; l < Levels; l++)
+      if (!lanes[l]->empty()) turns.age[l]++; // waited while a more urgent lane went first
+  }
+};
+
+}// uniq • Released under GPL 3.0
@@ -19,7 +19,7 @@ struct TimeTrace : Named { // trace record
 //===================================================================== Profiler
 struct Profiler : Named { 
 
-  OpenQueue<shared_ptr<TimeTrace>> traces; 
+  ElasticQueue<shared_ptr<TimeTrace>> traces; 
 
   // ~Profiler() { save(); }
 
@@ -29,7 +29,7 @@ struct Profiler : Named {
     log("{\"otherData\": {}, \"traceEvents\":[");
 
     shared_ptr<TimeTrace> t;
-    while(traces.pop(t)){
+    while(traces.pop(t, false)){
       out(" {", 
         "\"cat\":\"", name,"\"",
         ", \"name\":\"", t->name,"\"",
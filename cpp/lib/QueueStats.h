@@ -0,0 +1,123 @@
+//==============================================================================
+// QueueStats • Contention and occupancy counters for the queues
+//==============================================================================
+#pragma once
+namespace uniq {
+
+//=================================================================== QueueStats
+struct QueueStats {
+  static const int BUCKETS = 32;
+  u64 pushRetries = 0, popRetries = 0; // tickets lost to another thread
+  u64 fullWaits = 0, emptyWaits = 0;   // rounds that found the queue full/empty
+  u64 maxDepth = 0;                    // deepest queue seen by a push
+  u64 depth[BUCKETS] = {};             // pushes by depth, bucket b holds [2^(b-1), 2^b)
+
+  static inline int bucket(u64 d) { return d ? min(64 - __builtin_clzll(d), BUCKETS - 1) : 0; }
+
+  QueueStats& operator+=(const QueueStats& s) {
+    pushRetries += s.pushRetries; popRetries += s.popRetries;
+    fullWaits += s.fullWaits; emptyWaits += s.emptyWaits;
+    maxDepth = max(maxDepth, s.maxDepth);
+    for (int b = 0; b < BUCKETS; b++) depth[b] += s.depth[b];
+    return *this;
+  }
+
+  u64 pushes() const { u64 r = 0; for (auto n : depth) r += n; return r; }
+
+  string str() const {
+    string h;
+    for (int b = 0; b < BUCKETS; b++)
+      if (depth[b]) h += sstr(" <", 1ULL << b, ":", depth[b]);
+    return sstr("retries push ", pushRetries, " pop ", popRetries, ", waits full ", fullWaits,
+                " empty ", emptyWaits, ", max depth ", maxDepth, ", depth", h);
+  }
+};
+
+ostream& operator<<(ostream& os, const QueueStats& s) { return os << s.str(); }
+
+//==================================================================== Untracked
+struct Untracked { // the default, compiles down to nothing
+  inline void pushRetry() {}
+  inline void popRetry() {}
+  inline void fullWait() {}
+  inline void emptyWait() {}
+  inline void pushed(i64 depth) {}
+  QueueStats snapshot() { return {}; }
+};
+
+//====================================================================== Tracked
+// Every thread counts on its own block, so tracking adds no shared writes.
+// snapshot() sums the blocks of all threads that touched the queue.
+struct Tracked {
+  struct alignas(CACHE_LINE) Block : QueueStats {
+    thread::id owner;
+    Block* next;
+  };
+
+  atomic<Block*> blocks{nullptr};
+  const u64 serial = nextSerial(); // tells queues apart, even at a reused address
+
+  Tracked() {}
+  ~Tracked() {
+    for (Block *b = blocks, *n; b; b = n) { n = b->next; delete b; }
+  }
+
+  inline void pushRetry() { inc(local().pushRetries); }
+  inline void popRetry() { inc(local().popRetries); }
+  inline void fullWait() { inc(local().fullWaits); }
+  inline void emptyWait() { inc(local().emptyWaits); }
+
+  inline void pushed(i64 depth) {
+    Block& b = local();
+    u64 d = max<i64>(depth, 0);
+    if (d > b.maxDepth) __atomic_store_n(&b.maxDepth, d, __ATOMIC_RELAXED);
+    inc(b.depth[QueueStats::bucket(d)]);
+  }
+
+  QueueStats snapshot() {
+    QueueStats r;
+    for (Block* b = blocks.load(memory_order_acquire); b; b = b->next) {
+      QueueStats s;
+      s.pushRetries = load(b->pushRetries); s.popRetries = load(b->popRetries);
+      s.fullWaits = load(b->fullWaits); s.emptyWaits = load(b->emptyWaits);
+      s.maxDepth = load(b->maxDepth);
+      for (int i = 0; i < QueueStats::BUCKETS; i++) s.depth[i] = load(b->depth[i]);
+      r += s;
+    }
+    return r;
+  }
+
+ protected:
+  static u64 nextSerial() { static atomic<u64> n(0); return ++n; }
+
+  // only the owner writes, readers may look at any time
+  static inline void inc(u64& c) { __atomic_store_n(&c, c + 1, __ATOMIC_RELAXED); }
+  static inline u64 load(u64& c) { return __atomic_load_n(&c, __ATOMIC_RELAXED); }
+
+  Block& local() { // this thread's block, cached for the last queue it touched
+    static thread_local u64 lastSerial = 0;
+    static thread_local Block* last = nullptr;
+    if (lastSerial == serial) return *last;
+
+    thread::id me = this_thread::get_id();
+    Block* b = blocks.load(memory_order_acquire);
+    while (b && b->owner != me) b = b->next;
+    if (!b) {
+      b = new Block();
+      b->owner = me;
+      b->next = blocks.load(memory_order_relaxed);
+      while (!blocks.compare_exchange_weak(b->next, b, memory_order_release));
+    }
+    lastSerial = serial;
+    return *(last = b);
+  }
+};
+
+// build with -DQUEUE_STATS to track every queue that does not choose
+#ifdef QUEUE_STATS
+typedef Tracked QueueTracking;
+#else
+typedef Untracked QueueTracking;
+#endif
+
+}// uniq • Released under GPL 3.0
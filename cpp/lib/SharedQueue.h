@@ -0,0 +1,187 @@
+//==============================================================================
+// SharedQueue • The Queue protocol in shared memory, across processes
+//==============================================================================
+#pragma once
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+namespace uniq {
+
+// Header and slots live in one POSIX shm (attach by name) or memfd (inherit
+// through fork, or pass the fd) mapping. Nothing in it is a pointer, so every
+// process may map it at its own address. Items are copied straight into the
+// slots, hence trivially copyable. The wait strategy runs in each process,
+// only the polling ones (Spin, Yield, Backoff) see pushes from the others.
+template <typename T, typename Waiting = Backoff>
+class SharedQueue : public Actor<T> {
+  static_assert(is_trivially_copyable<T>::value, "SharedQueue items are copied as raw bytes");
+  static_assert(!is_base_of<Parking, Waiting>::value, "parking wakes one process only, use Spin, Yield or Backoff");
+  static_assert(atomic<u64>::is_always_lock_free, "the stamps must be address free");
+
+  static const u64 MAGIC = 0x756e697175657565; // "uniqueue" in ASCII, read as hex
+
+  struct alignas(CACHE_LINE) Slot {
+    atomic<u64> seq; // same stamps as Queue: ticket free, ticket+1 ready
+    T item;
+  };
+
+  struct alignas(CACHE_LINE) Header { // the slots follow it
+    atomic<u64> magic; // set last by the creator
+    u64 itemSize, slots;
+    alignas(CACHE_LINE) atomic<u64> in;
+    alignas(CACHE_LINE) atomic<u64> out;
+  };
+
+  Header* header = nullptr;
+  Slot* slots = nullptr;
+  size_t bytes = 0;
+  u64 mask = 0;
+  int fd = -1;
+
+  static inline i64 delta(u64 a, u64 b) { return i64(a - b); }
+  static size_t regionSize(u64 n) { return sizeof(Header) + n * sizeof(Slot); }
+
+ public:
+  Waiting notFull, notEmpty;
+
+  // opens the queue called name, creating it with size slots if nobody did
+  SharedQueue(const string& name, int size = 1) {
+    string path = "/" + name;
+    fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) create(size);
+    else if (errno != EEXIST) fail("shm_open " + path);
+    else if ((fd = shm_open(path.c_str(), O_RDWR, 0600)) >= 0) open();
+    else fail("shm_open " + path);
+  }
+
+  // an anonymous queue, for children and for whoever receives descriptor()
+  explicit SharedQueue(int size = 1) {
+    if ((fd = memfd_create("uniq::SharedQueue", MFD_CLOEXEC)) < 0) fail("memfd_create");
+    create(size);
+  }
+
+  // maps a queue from a memfd or shm descriptor we got from elsewhere
+  static unique_ptr<SharedQueue> attach(int descriptor) {
+    return unique_ptr<SharedQueue>(new SharedQueue(descriptor, true));
+  }
+
+  ~SharedQueue() {
+    if (header) munmap(header, bytes);
+    if (fd >= 0) close(fd);
+  }
+
+  // removes the name, mapped queues live on until their last process leaves
+  static void unlink(const string& name) { shm_unlink(("/" + name).c_str()); }
+
+  inline int descriptor() { return fd; }
+
+  u64 push(const T& item, bool wait = true) {
+    Header& h = *header;
+    u64 i;
+    Slot* s;
+    for (;;) {
+      if (!this->running()) return 0;
+      i = h.in.load(memory_order_relaxed);
+      s = &slots[i & mask];
+      i64 d = delta(s->seq.load(memory_order_acquire), i);
+      if (d == 0 && h.in.compare_exchange_weak(i, i + 1, memory_order_relaxed)) break;
+      if (d < 0) { // the previous lap item was not popped yet
+        this->onfull();
+        if (!wait) return 0;
+        notFull.wait([&]{ return writable(h.in.load(memory_order_relaxed)) || !this->running(); });
+      }
+    }
+    s->item = item;
+    s->seq.store(i + 1, memory_order_release);
+    notEmpty.notify();
+    return i + 1;
+  }
+
+  u64 pop(T& item, bool wait = true) {
+    Header& h = *header;
+    u64 o;
+    Slot* s;
+    for (;;) {
+      if (!this->running()) return 0;
+      o = h.out.load(memory_order_relaxed);
+      s = &slots[o & mask];
+      i64 d = delta(s->seq.load(memory_order_acquire), o + 1);
+      if (d == 0 && h.out.compare_exchange_weak(o, o + 1, memory_order_relaxed)) break;
+      if (d < 0) { // not produced yet
+        this->onempty();
+        if (!wait) return 0;
+        notEmpty.wait([&]{ return readable(h.out.load(memory_order_relaxed)) || !this->running(); });
+      }
+    }
+    item = s->item;
+    s->seq.store(o + mask + 1, memory_order_release);
+    notFull.notify();
+    return o + 1;
+  }
+
+  void stop() override { // this process only, the others keep going
+    Actor<T>::stop();
+    notFull.notify(INT_MAX);
+    notEmpty.notify(INT_MAX);
+  }
+
+  bool full() override { return size() > i64(mask); }
+  bool empty() override { return size() <= 0; }
+
+  int size() { return delta(header->in, header->out); }
+  u64 counter() { return header->out; } // jobs popped by all processes
+
+ protected:
+  SharedQueue(int descriptor, bool) : fd(dup(descriptor)) {
+    if (fd < 0) fail("dup");
+    open();
+  }
+
+  [[noreturn]] static void fail(const string& what) { throw system_error(errno, generic_category(), what); }
+
+  inline bool writable(u64 i) { return delta(slots[i & mask].seq.load(memory_order_acquire), i) >= 0; }
+  inline bool readable(u64 o) { return delta(slots[o & mask].seq.load(memory_order_acquire), o + 1) >= 0; }
+
+  void map(u64 n) {
+    bytes = regionSize(n);
+    void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) fail("mmap");
+    header = static_cast<Header*>(p);
+    slots = reinterpret_cast<Slot*>(header + 1);
+    mask = n - 1;
+  }
+
+  void create(int size) {
+    u64 n = 2; // as Queue, a stamp must tell ready from next lap
+    while (n < u64(size)) n *= 2;
+    if (ftruncate(fd, regionSize(n)) < 0) fail("ftruncate");
+    map(n); // fresh pages are zero, magic included
+
+    header->itemSize = sizeof(T);
+    header->slots = n;
+    header->in.store(0, memory_order_relaxed);
+    header->out.store(0, memory_order_relaxed);
+    for (u64 t = 0; t < n; t++) slots[t].seq.store(t, memory_order_relaxed);
+    header->magic.store(MAGIC, memory_order_release); // open for the others
+  }
+
+  void open() { // the creator may still be sizing or filling the region
+    struct stat st;
+    for (;;) {
+      if (fstat(fd, &st) < 0) fail("fstat");
+      if (size_t(st.st_size) >= sizeof(Header)) break;
+      sleep();
+    }
+
+    map(0); // the header alone
+    while (header->magic.load(memory_order_acquire) != MAGIC) sleep();
+    u64 n = header->slots, itemSize = header->itemSize;
+    munmap(header, bytes);
+    header = nullptr;
+
+    if (itemSize != sizeof(T)) { errno = EINVAL; fail("SharedQueue item size mismatch"); }
+    map(n);
+  }
+};
+
+}// uniq • Released under GPL 3.0
@@ -0,0 +1,141 @@
+//==============================================================================
+// Task • A move only void() call, inline up to 48 bytes, pooled beyond
+//==============================================================================
+#pragma once
+namespace uniq {
+
+//=================================================================== TaskMemory
+// Blocks of 64 to 1024 bytes for the tasks that don't fit inline and for the
+// pool's deque nodes. Each thread keeps a few per size, the rest is shared
+// through a Queue, so a block freed by a worker serves the next submitter.
+// Blocks are cache line aligned, so is what lives in them (FutureState).
+struct TaskMemory {
+  static const int CLASSES = 5; // 64 128 256 512 1024 bytes
+  static const int CACHED = 64; // blocks a thread keeps per class
+
+  static inline int sizeClass(size_t n) { int c = 0; while ((size_t(64) << c) < n) c++; return c; }
+
+  struct Shared {
+    Queue<void*, MPMC, Spin> spare[CLASSES] = {
+      Queue<void*, MPMC, Spin>(256), Queue<void*, MPMC, Spin>(256), Queue<void*, MPMC, Spin>(256),
+      Queue<void*, MPMC, Spin>(256), Queue<void*, MPMC, Spin>(256)};
+    ~Shared() {
+      void* p;
+      for (auto& s : spare) while (s.pop(p, false)) deallocate(p);
+    }
+  };
+
+  struct Cache {
+    vector<void*> spare[CLASSES];
+    Cache() { for (auto& s : spare) s.reserve(CACHED); }
+    ~Cache() { // back to the others, or to the system
+      for (int c = 0; c < CLASSES; c++)
+        for (void* p : spare[c]) if (!shared().spare[c].push(p, false)) deallocate(p);
+    }
+  };
+
+  static void* allocate(size_t n) { return ::operator new(n, align_val_t(CACHE_LINE)); }
+  static void deallocate(void* p) { ::operator delete(p, align_val_t(CACHE_LINE)); }
+
+  static Shared& shared() { static Shared s; return s; }
+  static Cache& cache() { static thread_local Cache c; return c; }
+
+  static void* get(size_t n) {
+    int c = sizeClass(n);
+    if (c >= CLASSES) return allocate(n);
+    auto& mine = cache().spare[c];
+    if (!mine.empty()) { void* p = mine.back(); mine.pop_back(); return p; }
+    void* p;
+    if (shared().spare[c].pop(p, false)) return p;
+    return allocate(size_t(64) << c);
+  }
+
+  static void put(void* p, size_t n) {
+    int c = sizeClass(n);
+    if (c >= CLASSES) return deallocate(p);
+    auto& mine = cache().spare[c];
+    if (mine.size() < CACHED) return mine.push_back(p);
+    if (!shared().spare[c].push(p, false)) deallocate(p);
+  }
+};
+
+//========================================================================= Task
+// Holds f (or f bound to args, like bind) in its own 48 bytes when it fits,
+// else in a TaskMemory block. A Task is one cache line and moves, never copies.
+class Task {
+  static const int INLINE = 48;
+
+  struct Ops {
+    void (*call)(void*);
+    void (*move)(void* from, void* to); // and leave from empty
+    void (*destroy)(void*);
+  };
+
+  template <typename F> static inline F& inlined(void* p) { return *launder(reinterpret_cast<F*>(p)); }
+  template <typename F> static inline F*& pooled(void* p) { return *reinterpret_cast<F**>(p); }
+
+  template <typename F> static constexpr bool fits =
+    sizeof(F) <= INLINE && alignof(F) <= alignof(max_align_t) && is_nothrow_move_constructible<F>::value;
+
+  template <typename F> static inline const Ops inlineOps = {
+    [](void* p) { inlined<F>(p)(); },
+    [](void* from, void* to) { new (to) F(move(inlined<F>(from))); inlined<F>(from).~F(); },
+    [](void* p) { inlined<F>(p).~F(); }};
+
+  template <typename F> static inline const Ops pooledOps = {
+    [](void* p) { (*pooled<F>(p))(); },
+    [](void* from, void* to) { pooled<F>(to) = pooled<F>(from); },
+    [](void* p) { F* f = pooled<F>(p); f->~F(); TaskMemory::put(f, sizeof(F)); }};
+
+  alignas(max_align_t) unsigned char data[INLINE];
+  const Ops* ops = nullptr;
+
+  template <typename F> void hold(F&& f) {
+    typedef typename decay<F>::type D;
+    static_assert(alignof(D) <= alignof(max_align_t), "over aligned tasks are not supported");
+    if constexpr (fits<D>) {
+      new (data) D(forward<F>(f));
+      ops = &inlineOps<D>;
+    } else {
+      pooled<D>(data) = new (TaskMemory::get(sizeof(D))) D(forward<F>(f));
+      ops = &pooledOps<D>;
+    }
+  }
+
+ public:
+  Task() {}
+
+  template <typename F, typename... Args, typename = typename enable_if<!is_same<typename decay<F>::type, Task>::value>::type>
+  Task(F&& f, Args&&... args) {
+    if constexpr (sizeof...(Args) == 0) hold(forward<F>(f));
+    else hold([f = forward<F>(f), a = make_tuple(forward<Args>(args)...)]() mutable { apply(f, a); });
+  }
+
+  Task(Task&& t) noexcept : ops(t.ops) {
+    if (ops) ops->move(t.data, data);
+    t.ops = nullptr;
+  }
+
+  Task& operator=(Task&& t) noexcept {
+    if (this == &t) return *this;
+    reset();
+    if ((ops = t.ops)) ops->move(t.data, data);
+    t.ops = nullptr;
+    return *this;
+  }
+
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() { reset(); }
+
+  inline void operator()() { ops->call(data); }
+  inline explicit operator bool() const { return ops; }
+
+  void reset() {
+    if (ops) ops->destroy(data);
+    ops = nullptr;
+  }
+};
+
+}// uniq • Released under GPL 3.0
@@ -0,0 +1,145 @@
+//==============================================================================
+// TaskGraph • Tasks run once their predecessors are done, again and again
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+// add() the nodes, edge(a, b) to have b wait for a, then execute(). Each node
+// keeps the count of its predecessors and, per run, a countdown from it; the
+// task that brings a countdown to zero runs that successor through the pool
+// from its own worker, so it lands on that worker's deque, LIFO, while the
+// data it left is still in cache. execute() resets the countdowns in place,
+// so a graph runs any number of times without allocating. A node that throws
+// cancels the run: its successors and the tasks not started yet are skipped,
+// and execute() rethrows. One execute() at a time per graph.
+class TaskGraph {
+  struct Node {
+    Task work; // called on every run, never consumed
+    vector<int> next;
+    int in = 0;              // predecessors
+    atomic<int> pending{0};  // predecessors still running, in this run
+    Node(Task&& work) : work(move(work)) {}
+    Node(Node&& n) : work(move(n.work)), next(move(n.next)), in(n.in) {}
+  };
+
+  ThreadPool& pool;
+  vector<Node> nodes;
+  vector<int> roots; // nodes without predecessors
+  bool checked = true;
+  TaskGroup* group = nullptr; // of the run going on
+
+  void step(int i) {
+    Node& n = nodes[i];
+    try {
+      n.work();
+    } catch (...) {
+      group->cancel();
+      throw; // for the group to keep
+    }
+    for (int s : n.next)
+      if (nodes[s].pending.fetch_sub(1, memory_order_acq_rel) == 1) group->run([this, s] { step(s); });
+  }
+
+  // finds the roots, throws when the edges make a cycle (it would never end)
+  void check() {
+    vector<int> in(nodes.size()), ready;
+    roots.clear();
+    for (size_t i = 0; i < nodes.size(); i++)
+      if (!(in[i] = nodes[i].in)) roots.push_back(i);
+    ready = roots;
+    size_t seen = 0;
+    for (; seen < ready.size(); seen++)
+      for (int s : nodes[ready[seen]].next)
+        if (!--in[s]) ready.push_back(s);
+    if (seen < nodes.size()) throw logic_error("TaskGraph has a cycle");
+    checked = true;
+  }
+
+ public:
+  TaskGraph(ThreadPool& pool = uniq::pool()) : pool(pool) {}
+
+  TaskGraph(const TaskGraph&) = delete;
+  TaskGraph& operator=(const TaskGraph&) = delete;
+
+  // a node calling f(args...) on each run, returns its index for edge()
+  template <typename Func, typename... Args>
+  int add(Func&& f, Args&&... args) {
+    nodes.emplace_back(Task(forward<Func>(f), forward<Args>(args)...));
+    checked = false;
+    return nodes.size() - 1;
+  }
+
+  // to runs after from is done
+  void edge(int from, int to) {
+    if (from < 0 || to < 0 || from >= size() || to >= size() || from == to)
+      throw out_of_range(sstr("TaskGraph edge ", from, " => ", to));
+    nodes[from].next.push_back(to);
+    nodes[to].in++;
+    checked = false;
+  }
+
+  int size() { return nodes.size(); }
+
+  // runs every node once, in dependency order, and waits helping the pool.
+  // A cancelled token skips the nodes not started yet
+  void execute(const CancellationToken& token = CancellationToken()) {
+    if (!checked) check();
+    for (auto& n : nodes) n.pending.store(n.in, memory_order_relaxed);
+    TaskGroup run(pool, token);
+    group = &run;
+    for (int r : roots) run.run([this, r] { step(r); }); // the group's counting publishes the resets
+    try {
+      run.wait();
+    } catch (...) {
+      group = nullptr;
+      throw;
+    }
+    group = nullptr;
+  }
+};
+
+// tests =======================================================================
+TEST(TaskGraph) {
+  ThreadPool p(2);
+  TaskGraph g(p);
+  atomic<int> clock(0), runs(0);
+  int at[5]; // when each node ran, in this run
+  auto stage = [&](int i) { at[i] = clock++; runs++; };
+  int a = g.add(stage, 0), b = g.add(stage, 1), c = g.add(stage, 2), d = g.add(stage, 3), e = g.add(stage, 4);
+  g.edge(a, b), g.edge(a, c), g.edge(b, d), g.edge(c, d), g.edge(d, e); // a diamond, then a tail
+  bool ordered = true;
+  for (int r = 0; r < 100; r++) { // the same graph, over and over
+    clock = 0;
+    g.execute();
+    ordered = ordered && at[a] == 0 && at[b] < at[d] && at[c] < at[d] && at[e] == 4;
+  }
+  CHECK(ordered && runs == 500);
+
+  TaskGraph wide(p); // one root feeding many, all spawned on the finishing worker
+  atomic<int> leaves(0);
+  int root = wide.add([] {});
+  for (int i = 0; i < 200; i++) wide.edge(root, wide.add([&] { leaves++; }));
+  wide.execute();
+  wide.execute();
+  CHECK(leaves == 400);
+
+  TaskGraph failing(p); // a throw skips the successors
+  int f = failing.add([] { throw runtime_error("no"); });
+  failing.edge(f, failing.add([&] { runs++; }));
+  bool caught = false;
+  try { failing.execute(); } catch (runtime_error&) { caught = true; }
+  CHECK(caught && runs == 500);
+
+  TaskGraph cycle(p);
+  int x = cycle.add([] {}), y = cycle.add([] {});
+  cycle.edge(x, y), cycle.edge(y, x);
+  caught = false;
+  try { cycle.execute(); } catch (logic_error&) { caught = true; }
+  CHECK(caught);
+
+  p.close();
+  p.join();
+}
+
+}// uniq • Released under GPL 3.0
@@ -0,0 +1,143 @@
+//==============================================================================
+// TaskGroup • Runs tasks on a ThreadPool and waits for all of them
+//==============================================================================
+#pragma once
+#include "uniq.h"
+namespace uniq {
+
+// run() counts a task in, its end counts it out. wait() runs pool tasks until
+// the count is zero, then sleeps on the count itself, so a group waiting in a
+// task of another group (they nest) keeps its worker busy. The pool goes on
+// running, a group is cheap enough to make one per batch.
+// cancel() makes the tasks not started yet end as soon as they are popped,
+// and long tasks may poll token() to stop halfway. A group made with the
+// token() of another is cancelled with it.
+class TaskGroup {
+  ThreadPool& pool;
+  CancellationSource source;
+  atomic<int> pending{0}; // also the futex word wait() sleeps on
+  atomic<bool> failed{false};
+  exception_ptr error; // the first one thrown
+
+  // the last task out wakes the sleepers. The group may be gone right after
+  // the count hits zero, so only the syscall sees the address again
+  void finish() {
+    if (pending.fetch_sub(1, memory_order_acq_rel) == 1)
+      syscall(SYS_futex, &pending, FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+ public:
+  atomic<u64> skipped{0}; // tasks cancelled before they started
+
+  TaskGroup(ThreadPool& pool = uniq::pool(), const CancellationToken& parent = CancellationToken())
+    : pool(pool), source(parent) {}
+  ~TaskGroup() { join(); }
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  template <typename Func, typename... Args>
+  inline u64 run(Func&& f, Args&&... args) {
+    return run(NORMAL, forward<Func>(f), forward<Args>(args)...);
+  }
+
+  template <typename Func, typename... Args>
+  u64 run(Priority p, Func&& f, Args&&... args) {
+    pending.fetch_add(1, memory_order_relaxed);
+    u64 id = pool.run(p, [this, f = forward<Func>(f), a = make_tuple(forward<Args>(args)...)]() mutable {
+      try {
+        if (source.cancelled()) skipped.fetch_add(1, memory_order_relaxed);
+        else apply(f, a);
+      } catch (...) {
+        if (!failed.exchange(true)) error = current_exception();
+      }
+      finish();
+    });
+    if (!id) finish(); // the pool is closed, the task was dropped, from workers too
+    return id;
+  }
+
+  int size() { return pending.load(memory_order_acquire); } // tasks not finished yet
+
+  void cancel() { source.cancel(); }
+  bool cancelled() { return source.cancelled(); }
+  CancellationToken token() { return source.token(); }
+
+  // waits for every task run so far, helping, without rethrowing. A worker
+  // helps its own pool, as Future::wait()
+  void join() {
+    ThreadPool& helped = ThreadPool::owner ? *ThreadPool::owner : pool;
+    timespec ms = {0, 1'000'000}; // new work may come meanwhile, have a look
+    for (int p; (p = pending.load(memory_order_acquire));)
+      if (!helped.help()) syscall(SYS_futex, &pending, FUTEX_WAIT_PRIVATE, p, &ms, nullptr, 0);
+  }
+
+  // joins, then rethrows the first exception a task threw
+  void wait() {
+    join();
+    if (!failed.load(memory_order_acquire)) return;
+    exception_ptr e = move(error);
+    failed = false;
+    rethrow_exception(e);
+  }
+};
+
+// tests =======================================================================
+TEST(TaskGroup) {
+  ThreadPool p(2);
+  atomic<int> n(0);
+  for (int batch = 1; batch <= 3; batch++) { // the pool survives the batches
+    TaskGroup g(p);
+    for (int i = 0; i < 100; i++) g.run([&](int k) { n += k; }, batch);
+    g.wait();
+    CHECK(n == 100 * batch * (batch + 1) / 2 && g.size() == 0);
+  }
+
+  n = 0;
+  TaskGroup outer(p); // nested groups, each inner wait runs inside a task
+  for (int i = 0; i < 8; i++)
+    outer.run([&] {
+      TaskGroup inner(p);
+      for (int j = 0; j < 8; j++) inner.run([&] { n++; });
+      inner.wait();
+    });
+  outer.wait();
+  CHECK(n == 64);
+
+  TaskGroup failing(p);
+  failing.run([] { throw runtime_error("no"); });
+  failing.run([&] { n++; });
+  bool caught = false;
+  try { failing.wait(); } catch (runtime_error&) { caught = true; }
+  CHECK(caught && n == 65);
+
+  atomic<bool> go(false); // cancelled while queued: popped, not run
+  TaskGroup stopping(p);
+  CancellationToken t = stopping.token();
+  TaskGroup child(p, t);
+  for (int i = 0; i < 2; i++) stopping.run([&] { while (!go) sleep(); });
+  for (int i = 0; i < 50; i++) child.run([&] { n++; }); // fits the lane, nobody pops
+  stopping.cancel();
+  go = true;
+  stopping.wait();
+  child.wait();
+  CHECK(n == 65 && child.skipped == 50 && t.cancelled() && child.cancelled());
+
+  p.close();
+  TaskGroup late(p);
+  CHECK(!late.run([&] { n++; }) && late.size() == 0);
+  late.wait();
+  p.join();
+
+  ThreadPool q(1); // from one of its workers too, once closed
+  atomic<bool> refused(false);
+  q.run([&] {
+    q.close();
+    TaskGroup g(q);
+    refused = !g.run([&] { n++; }) && g.size() == 0;
+  });
+  q.join();
+  CHECK(refused && n == 65);
+}
+
+}// uniq • Released under GPL 3.0
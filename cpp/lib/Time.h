@@ -127,9 +127,21 @@ inline u64 ticks(u64 prev) { return ticks()-prev;}
 
 const u64 START_TICKS = ticks();
 
-const double CLOCK_CYCLE = NANO / 2.4; // todo: dynamic update
-
-inline Time CpuTime() { return (ticks()-START_TICKS) * CLOCK_CYCLE; } // 13ns 
+// seconds per tick, measured against CLOCK_MONOTONIC. The TSC ticks at a
+// constant rate, but not at the same one on every machine. The 1ms it takes
+// is spent once per process, by the first caller
+inline double clockCycle() {
+  static const double cycle = [] {
+    auto now = [] { timespec t; clock_gettime(CLOCK_MONOTONIC, &t); return t.tv_sec + NANO * t.tv_nsec; };
+    double t0 = now(), t1;
+    u64 c0 = ticks();
+    while ((t1 = now()) - t0 < 0.001) {}
+    return (t1 - t0) / max<u64>(ticks(c0), 1);
+  }();
+  return cycle;
+}
+
+inline Time CpuTime() { return (ticks()-START_TICKS) * clockCycle(); } // 13ns 
 inline Time CpuTime(Time prev) { return CpuTime()-prev;}
 
 
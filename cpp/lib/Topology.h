@@ -0,0 +1,173 @@
+//==============================================================================
+// Topology • CPUs, cores, last level caches and NUMA nodes, for placement
+//==============================================================================
+#pragma once
+#include <sched.h>    // sched_getaffinity
+#include <sys/stat.h> // mkdir, for the test
+#include "uniq.h"
+namespace uniq {
+
+// where ThreadPool workers go: left to the OS, packed on neighbour CPUs
+// (sharing cores and caches), spread over nodes and caches, or one per core
+enum Placement { UNPINNED, COMPACT, SCATTER, CORES };
+
+struct Cpu {
+  int id;
+  int thread = 0; // among its core's SMT siblings
+  int core = 0, llc = 0, node = 0; // indexes into the Topology
+};
+
+//==================================================================== Topology
+// Read from sysfs for the CPUs this process may run on. Whatever is missing,
+// as in containers or single node machines, reads as one node, one cache and
+// a core per CPU, so the placements still work, only less informed.
+struct Topology {
+  vector<Cpu> cpus;
+  int cores = 0, llcs = 0, nodes = 0;
+
+  Topology(vector<int> ids = allowed(), string root = "/sys/devices/system") {
+    map<pair<int, int>, int> coreOf; // (package, core_id) => core
+    map<int, int> llcOf;             // first CPU sharing it => llc
+    map<int, int> nodeOf = nodeMap(root);
+    map<int, int> siblings;          // CPUs seen per core so far
+    for (int id : ids) {
+      Cpu c{id};
+      string t = sstr(root, "/cpu/cpu", id, "/topology/");
+      int package = number(t + "physical_package_id", 0), core = number(t + "core_id", id);
+      c.core = coreOf.emplace(make_pair(package, core), coreOf.size()).first->second;
+      c.thread = siblings[c.core]++;
+      c.llc = llcOf.emplace(lastCache(root, id), llcOf.size()).first->second;
+      c.node = nodeOf.count(id) ? nodeOf[id] : 0;
+      cpus.push_back(c);
+    }
+    cores = coreOf.size(), llcs = llcOf.size();
+    for (auto& c : cpus) nodes = max(nodes, c.node + 1);
+  }
+
+  // the CPU for each of n workers, wrapping around when n > cpus.size()
+  vector<int> place(Placement p, int n) {
+    vector<Cpu> order = cpus;
+    auto by = [&](auto key) { stable_sort(order.begin(), order.end(), [&](const Cpu& a, const Cpu& b) { return key(a) < key(b); }); };
+    if (p == COMPACT) by([](const Cpu& c) { return make_tuple(c.node, c.llc, c.core, c.thread); });
+    if (p == CORES) by([](const Cpu& c) { return make_tuple(c.thread, c.node, c.llc, c.core); });
+    if (p == SCATTER) { // round robin on nodes, then on their caches, then on cores
+      map<int, int> coreRank, llcRank, seenCores, seenLlcs;
+      for (auto& c : cpus) {
+        if (!coreRank.count(c.core)) coreRank[c.core] = seenCores[c.llc]++;
+        if (!llcRank.count(c.llc)) llcRank[c.llc] = seenLlcs[c.node]++;
+      }
+      by([&](const Cpu& c) { return make_tuple(c.thread, coreRank[c.core], llcRank[c.llc], c.node); });
+    }
+    vector<int> r;
+    for (int i = 0; i < n && order.size(); i++) r.push_back(order[i % order.size()].id);
+    return r;
+  }
+
+  // binds the calling thread to cpu, false when the OS said no
+  static bool pin(int cpu) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return !pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+  }
+
+  static vector<int> allowed() { // the CPUs of our affinity mask
+    vector<int> r;
+    cpu_set_t set;
+    if (!sched_getaffinity(0, sizeof(set), &set))
+      for (int i = 0; i < CPU_SETSIZE; i++) if (CPU_ISSET(i, &set)) r.push_back(i);
+    if (r.empty()) for (int i = 0, n = max(1u, thread::hardware_concurrency()); i < n; i++) r.push_back(i);
+    return r;
+  }
+
+  // "0-3,8,10-11" => 0 1 2 3 8 10 11
+  static vector<int> cpuList(const string& s) {
+    vector<int> r;
+    stringstream ss(s);
+    for (string part; getline(ss, part, ',');) {
+      if (part.empty()) continue;
+      size_t dash = part.find('-');
+      int a = stoi(part), b = dash == string::npos ? a : stoi(part.substr(dash + 1));
+      for (int i = a; i <= b; i++) r.push_back(i);
+    }
+    return r;
+  }
+
+ protected:
+  static string text(const string& file) {
+    ifstream f(file);
+    string s;
+    getline(f, s);
+    return s;
+  }
+
+  static int number(const string& file, int otherwise) {
+    string s = text(file);
+    return s.empty() ? otherwise : stoi(s);
+  }
+
+  // the first CPU sharing the highest level cache of cpu, -1 when unknown
+  static int lastCache(const string& root, int cpu) {
+    int best = -1, level = 0;
+    for (int i = 0;; i++) {
+      string dir = sstr(root, "/cpu/cpu", cpu, "/cache/index", i, "/");
+      int l = number(dir + "level", -1);
+      if (l < 0) break;
+      vector<int> shared = cpuList(text(dir + "shared_cpu_list"));
+      if (l >= level && shared.size()) level = l, best = shared[0];
+    }
+    return best;
+  }
+
+  static map<int, int> nodeMap(const string& root) { // cpu => node
+    map<int, int> r;
+    vector<int> nodes = cpuList(text(root + "/node/online"));
+    for (int n : nodes)
+      for (int cpu : cpuList(text(sstr(root, "/node/node", n, "/cpulist")))) r[cpu] = n;
+    return r;
+  }
+};
+
+inline Topology& topology() {
+  static Topology t;
+  return t;
+}
+
+// tests =======================================================================
+void test_sysfs(const string& root) { // 2 nodes, 1 cache each, 2 cores of 2 threads
+  auto put = [](const string& file, const string& s) { ofstream(file) << s << "\n"; };
+  auto dir = [](const string& d) { mkdir(d.c_str(), 0755); };
+  for (auto d : {"", "/cpu", "/node", "/node/node0", "/node/node1"}) dir(root + d);
+  put(root + "/node/online", "0-1");
+  put(root + "/node/node0/cpulist", "0-3");
+  put(root + "/node/node1/cpulist", "4-7");
+  for (int cpu = 0; cpu < 8; cpu++) {
+    string c = sstr(root, "/cpu/cpu", cpu);
+    for (auto d : {"", "/topology", "/cache", "/cache/index0"}) dir(c + d);
+    put(c + "/topology/physical_package_id", to_string(cpu / 4));
+    put(c + "/topology/core_id", to_string(cpu % 2)); // siblings are cpu and cpu^2
+    put(c + "/cache/index0/level", "3");
+    put(c + "/cache/index0/shared_cpu_list", cpu < 4 ? "0-3" : "4-7");
+  }
+}
+
+TEST(Topology) {
+  CHECK(Topology::cpuList("0-2,5,7-8") == vector<int>({0, 1, 2, 5, 7, 8}));
+
+  string root = sstr("/tmp/uniq-sysfs-", getpid());
+  test_sysfs(root);
+  Topology t({0, 1, 2, 3, 4, 5, 6, 7}, root);
+  CHECK(t.cores == 4 && t.llcs == 2 && t.nodes == 2);
+  CHECK(t.place(COMPACT, 4) == vector<int>({0, 2, 1, 3}));  // both threads of a core, then the next
+  CHECK(t.place(CORES, 5) == vector<int>({0, 1, 4, 5, 2})); // a core each, siblings when out of cores
+  CHECK(t.place(SCATTER, 4) == vector<int>({0, 4, 1, 5}));  // alternating nodes
+  system(sstr("rm -rf ", root).c_str());
+
+  Topology none({0, 1, 2}, "/nonexistent"); // no sysfs: a core per CPU, one node
+  CHECK(none.cores == 3 && none.nodes == 1 && none.place(SCATTER, 4) == vector<int>({0, 1, 2, 0}));
+  bool pinned = false; // on a thread of its own, the others would inherit it
+  thread([&] { pinned = Topology::pin(topology().cpus[0].id); }).join();
+  CHECK(topology().cpus.size() >= 1 && pinned);
+}
+
+}// uniq • Released under GPL 3.0
@@ -0,0 +1,179 @@
+//==============================================================================
+// Wait • Strategies to wait for a condition: spin, yield, backoff, park ...
+//==============================================================================
+#pragma once
+#include <linux/futex.h>
+#include <sys/syscall.h>
+namespace uniq {
+
+inline void cpuRelax() { __builtin_ia32_pause(); } // PAUSE, cheap on the sibling core
+
+const double FOREVER = INFINITY; // a deadline that never comes
+
+// deadlines are CpuTime()s, reading them is a rdtscp, never a syscall
+inline bool expired(Time deadline) { return double(deadline) < FOREVER && CpuTime() >= deadline; }
+
+//==================================================================== WaitStats
+struct WaitStats { // cpu ticks spent on each phase of the waits
+  u64 waits = 0, spin = 0, yield = 0, sleep = 0, park = 0;
+  u64 timeouts = 0; // waits that reached their deadline
+
+  inline void add(u64 &phase, u64 t) { __atomic_fetch_add(&phase, t, __ATOMIC_RELAXED); }
+
+  WaitStats& operator+=(const WaitStats& s) {
+    waits += s.waits; spin += s.spin; yield += s.yield; sleep += s.sleep; park += s.park;
+    timeouts += s.timeouts;
+    return *this;
+  }
+
+  inline Time time(u64 phase) const { return phase * clockCycle(); }
+  Time total() const { return time(spin + yield + sleep + park); }
+
+  string str() const {
+    Time s = time(spin), y = time(yield), z = time(sleep), p = time(park);
+    return sstr(waits, " waits, ", timeouts, " timeouts, spin ", s, " yield ", y, " sleep ", z, " park ", p);
+  }
+};
+
+ostream& operator<<(ostream& os, const WaitStats& s) { return os << s.str(); }
+
+//================================================================= WaitStrategy
+// A strategy blocks in wait(ready, deadline) until ready() is true or the
+// deadline passed, returning ready(). notify(n) tells it that up to n waiters
+// may proceed. The phases below are the bricks, each one gives up at deadline.
+struct WaitStrategy {
+  WaitStats stats;
+  inline void notify(int n = 1) {}
+
+ protected:
+  template <typename F> bool spin(F& ready, u64 limit, Time deadline) {
+    u64 t = ticks(), n = 0;
+    bool r;
+    while (!(r = ready()) && n++ < limit && (n & 63 || !expired(deadline))) cpuRelax();
+    stats.add(stats.spin, ticks(t));
+    return r;
+  }
+
+  template <typename F> bool yield(F& ready, u64 limit, Time deadline) {
+    u64 t = ticks(), n = 0;
+    bool r;
+    while (!(r = ready()) && n++ < limit && !expired(deadline)) sched_yield();
+    stats.add(stats.yield, ticks(t));
+    return r;
+  }
+
+  // exponential backoff: pauses doubling up to maxSpin, then sleeps doubling up to maxSleep
+  template <typename F> bool backoff(F& ready, u64 maxSpin, u64 maxSleep, Time deadline) {
+    u64 t = ticks(), n = 1;
+    for (; !ready() && n <= maxSpin && !expired(deadline); n *= 2)
+      for (u64 i = 0; i < n; i++) cpuRelax();
+    stats.add(stats.spin, ticks(t));
+
+    t = ticks();
+    bool r;
+    for (n = 1; !(r = ready()); n = min(2 * n, maxSleep)) {
+      double left = double(deadline) - double(CpuTime());
+      if (left <= 0) break;
+      this_thread::sleep_for(chrono::microseconds(min<u64>(n, left * MEGA + 1)));
+    }
+    stats.add(stats.sleep, ticks(t));
+    return r;
+  }
+
+  template <typename F> bool begin(F& ready) {
+    if (ready()) return true;
+    stats.add(stats.waits, 1);
+    return false;
+  }
+
+  inline bool end(bool ready) { // counts the timeouts
+    if (!ready) stats.add(stats.timeouts, 1);
+    return ready;
+  }
+};
+
+//====================================================================== Parking
+// Futex park/unpark. Waiters sleep on an epoch word; notify bumps it and wakes
+// them, paying a fence and a load when nobody sleeps.
+struct Parking {
+  alignas(CACHE_LINE) atomic<u32> epoch{0};
+  atomic<int> sleepers{0};
+
+  template <typename F> bool park(F& ready, Time deadline = FOREVER) {
+    for (;;) {
+      timespec ts, *timeout = nullptr;
+      if (double(deadline) < FOREVER) { // futex takes a relative timeout
+        double left = double(deadline) - double(CpuTime());
+        if (left <= 0) return ready();
+        ts.tv_sec = time_t(left);
+        ts.tv_nsec = long((left - ts.tv_sec) * GIGA);
+        timeout = &ts;
+      }
+      u32 e = epoch.load(memory_order_acquire);
+      sleepers.fetch_add(1);
+      if (ready()) { sleepers.fetch_sub(1); return true; }
+      syscall(SYS_futex, &epoch, FUTEX_WAIT_PRIVATE, e, timeout, nullptr, 0);
+      sleepers.fetch_sub(1);
+      if (ready()) return true;
+    }
+  }
+
+  inline void unpark(int n = 1) {
+    atomic_thread_fence(memory_order_seq_cst); // order the caller's publish before reading sleepers
+    if (!sleepers.load(memory_order_relaxed)) return;
+    epoch.fetch_add(1, memory_order_release);
+    syscall(SYS_futex, &epoch, FUTEX_WAKE_PRIVATE, n, nullptr, nullptr, 0);
+  }
+};
+
+//========================================================================= Spin
+struct Spin : WaitStrategy { // lowest latency, burns the core while waiting
+  template <typename F> bool wait(F&& ready, Time deadline = FOREVER) {
+    return begin(ready) || end(spin(ready, ~0ULL, deadline));
+  }
+};
+
+//======================================================================== Yield
+struct Yield : WaitStrategy { // sched_yield loop, the classic uniq behavior
+  template <typename F> bool wait(F&& ready, Time deadline = FOREVER) {
+    return begin(ready) || end(yield(ready, ~0ULL, deadline));
+  }
+};
+
+//====================================================================== Backoff
+struct Backoff : WaitStrategy { // spins, then sleeps longer and longer
+  u64 maxSpin = 1024;  // pauses
+  u64 maxSleep = 1000; // µs
+  template <typename F> bool wait(F&& ready, Time deadline = FOREVER) {
+    return begin(ready) || end(backoff(ready, maxSpin, maxSleep, deadline));
+  }
+};
+
+//========================================================================= Park
+struct Park : WaitStrategy, Parking { // sleeps in the kernel until notified
+  template <typename F> bool wait(F&& ready, Time deadline = FOREVER) {
+    if (begin(ready)) return true;
+    u64 t = ticks();
+    bool r = park(ready, deadline);
+    stats.add(stats.park, ticks(t));
+    return end(r);
+  }
+  inline void notify(int n = 1) { unpark(n); }
+};
+
+//===================================================================== Adaptive
+struct Adaptive : WaitStrategy, Parking { // spins, yields a bit, then parks
+  u64 spins = 256; // pauses before yielding
+  u64 yields = 8;  // yields before parking
+
+  template <typename F> bool wait(F&& ready, Time deadline = FOREVER) {
+    if (begin(ready) || spin(ready, spins, deadline) || yield(ready, yields, deadline)) return true;
+    u64 t = ticks();
+    bool r = park(ready, deadline);
+    stats.add(stats.park, ticks(t));
+    return end(r);
+  }
+  inline void notify(int n = 1) { unpark(n); }
+};
+
+}// uniq • Released under GPL 3.0
@@ -5,21 +5,23 @@
 #include "uniq.h"
 namespace uniq {
 
-thread_local int TaskID = 0;  // the id of the current TaskID TaskID
+thread_local u64 TaskID = 0;  // the id of the current TaskID TaskID
 
-class Worker : public Queue<voidfunction> { 
+// many threads may run() into a Worker, but only its own thread pops
+template <typename Policy = MPSC, typename Waiting = Adaptive>
+class Worker : public Queue<Task, Policy, Waiting> { 
  private:
   integer id = Id("Worker");
   thread thrd;
 
  public:
 
-  Worker(int queueSize = 1) : Queue<voidfunction>(queueSize) {
+  Worker(int queueSize = 1) : Queue<Task, Policy, Waiting>(queueSize) {
     this->beat = [&]{
-      voidfunction f;
+      Task f;
       while (this->running()) {
         try {
-          while ((TaskID = pop(f))) {
+          while ((TaskID = this->pop(f))) {
             f();
             // counter++;
           }
@@ -37,14 +39,14 @@ class Worker : public Queue<voidfunction> {
   void loop(){ this->beat(); }
 
   template <typename Func, typename... Args>
-  inline int run(Func&& f, Args&&... args) {
-    return Queue::push(bind(forward<Func>(f), forward<Args>(args)...));
+  inline u64 run(Func&& f, Args&&... args) {
+    return Queue<Task, Policy, Waiting>::push(Task(forward<Func>(f), forward<Args>(args)...));
   }
 
   // template <typename Func, typename... Args>
   // inline int chain(int id, Func&& f, Args&&... args) {
   //   auto fchain = [=]{ }
-  //   return Queue::push(bind(forward<Func>(f), forward<Args>(args)...));
+  //   return Queue::push(Task(forward<Func>(f), forward<Args>(args)...));
   // }
 
   void join() { thrd.join(); }
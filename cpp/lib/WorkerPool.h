@@ -1,56 +1,144 @@
+//==============================================================================
+// WorkerPool • A queue of tasks served by as many threads as the load asks
+//==============================================================================
 #pragma once
 #include "uniq.h"
 namespace uniq {
 
-class WorkerPool;
+// The pool grows a worker when a push finds the queue full (onfull), when it
+// is fuller than occupancy, or when a task waited longer than maxWait. A
+// worker that finds nothing for idle retires, down to min. Every change in
+// the worker count calls onresize(size, was), from the thread that made it.
+// It is given with the limits, so it is there before the first worker starts.
+struct Elastic {
+  int min = 1;
+  int max = coreCount();
+  double occupancy = 0.5; // of the queue capacity
+  Time maxWait = 0.001;   // s a task may wait before another worker comes
+  Time idle = 0.1;        // s without work before a worker retires
+  function<void(int size, int was)> onresize;
+};
 
-struct Helper : public Worker {
-  integer id = Id("Helper");
-  WorkerPool& pool;
-  Helper(WorkerPool &pool) : pool(pool) { 
-    // thrd = thread(&Helper::beat, this);
-  }
-  void loop();
+struct Job {
+  Task task;
+  u64 stamp = 0; // ticks() when queued
 };
 
 // ================================================================== WorkerPool
-struct WorkerPool : public Worker {
-  OpenQueue<Worker*> workers = OpenQueue<Worker*>(coreCount());
+struct WorkerPool : public Queue<Job, MPMC, Adaptive> {
+  typedef Queue<Job, MPMC, Adaptive> Jobs;
 
-  WorkerPool(int queueSize = 1) : Worker(queueSize) { 
-    workers.push(this); 
-    // lambda = [](){ };
-  };
+  Elastic limits;
+  int capacity;
+  atomic<int> workers{0}; // alive, including those about to retire
+  atomic<u64> grown{0}, retired{0};
+  bool showstats = false;
+
+  WorkerPool(int queueSize = 64, Elastic limits = Elastic()) : Jobs(queueSize), limits(limits), capacity(queueSize) {
+    this->limits.max = std::max(this->limits.max, std::max(this->limits.min, 1));
+    for (int i = 0; i < this->limits.min; i++) grow();
+  }
+
+  ~WorkerPool() {
+    close();
+    join();
+  }
 
-  void onfull() override {
-    Helper* h;
-    if (workers.size() < 2) { //coreCount()
-      h = new Helper(*this);
-      workers.push(h);
-      log("helper", h->id);
+  template <typename Func, typename... Args>
+  inline u64 run(Func&& f, Args&&... args) {
+    u64 id = Jobs::emplace(Job{Task(forward<Func>(f), forward<Args>(args)...), ticks()});
+    if (size() > limits.occupancy * capacity || !workers.load(memory_order_relaxed)) grow();
+    return id;
+  }
+
+  int size() { return Jobs::size(); }
+  int threads() { return workers.load(memory_order_acquire); }
+
+  // waits for every worker to leave, after stop() or close()
+  void join() {
+    for (;;) {
+      reap();
+      thread t;
+      {
+        lock_guard<mutex> hold(lock); // not held while joining, leaving takes it
+        if (alive.empty()) return;
+        t = move(alive.begin()->second);
+        alive.erase(alive.begin());
+      }
+      t.join();
     }
   }
 
-  bool showstats = false;
-  // friend Helper;
-};
+ protected:
+  mutex lock; // on alive and gone
+  map<int, thread> alive;
+  vector<int> gone; // retired, to be joined
+  int serial = 0;
 
-// ============================================================== Helper::beat()
-void Helper::loop() {
-  voidfunction f;
-  while(running){
-    try {
-      // while ((TaskID=pop(f,0)) || (TaskID=pool.pop(f,0))) 
-      while (TaskID=pool.pop(f,0)) 
-        f();
-        stop();
-      // todo: remover o helper da lista de helpers
-      // pool.release()
-    } catch (...) { handle_exception(); };
-  };
-  sleep(100);
-  uniq::out(".");
-  // if(showstats) out("\n", colorcode(id), sstr("worker[", id, "] handled ", done, " messages in ", total));
+  void onfull() override { grow(); }
+
+  void resized(int size, int was) {
+    if (showstats) uniq::out("\n", sstr("WorkerPool ", was, " => ", size, " workers"));
+    if (limits.onresize) limits.onresize(size, was);
+  }
+
+  // one more worker, unless at max
+  bool grow() {
+    int n = workers.load(memory_order_relaxed);
+    do if (n >= limits.max || !this->running() || this->closed()) return false;
+    while (!workers.compare_exchange_weak(n, n + 1, memory_order_acq_rel));
+    reap();
+    {
+      lock_guard<mutex> hold(lock);
+      int id = ++serial;
+      alive[id] = thread(&WorkerPool::work, this, id);
+    }
+    grown++;
+    resized(n + 1, n);
+    return true;
+  }
+
+  // one less worker, unless at min
+  bool retire() {
+    int n = workers.load(memory_order_relaxed);
+    do if (n <= limits.min) return false;
+    while (!workers.compare_exchange_weak(n, n - 1, memory_order_acq_rel));
+    retired++;
+    resized(n - 1, n);
+    return true;
+  }
+
+  void reap() { // joins the retired workers
+    vector<thread> done;
+    {
+      lock_guard<mutex> hold(lock);
+      for (int id : gone)
+        if (alive.count(id)) done.push_back(move(alive[id])), alive.erase(id);
+      gone.clear();
+    }
+    for (auto& t : done) t.join();
+  }
+
+  void work(int id) {
+    Job job;
+    for (bool leaving = false; !leaving;) {
+      if ((TaskID = Jobs::tryPopFor(job, limits.idle))) {
+        if (ticks(job.stamp) * clockCycle() > double(limits.maxWait) && Jobs::size()) grow();
+        try {
+          job.task();
+        } catch (...) {
+          handle_exception();
+        }
+        job.task.reset();
+      } else if (!this->running() || this->drained()) { // the pool ends
+        int n = workers.fetch_sub(1, memory_order_acq_rel);
+        resized(n - 1, n);
+        return;
+      } else leaving = retire();
+    }
+    lock_guard<mutex> hold(lock);
+    gone.push_back(id);
+  }
 };
 
 // ====================================================================== pool()
@@ -59,54 +147,30 @@ inline WorkerPool& workerPool() {
   return p;
 }
 
- // template <typename Func>
-  // map<string, Func> funcs;
-  // mutex mutex;
-
-  // template <typename Func>
-  // void register(const string name, Func &&f){
-  //   lock_guard<mutex> lock(mutex);
-  //   funcs.insert({name, f});
-  // };
-
-  // template <typename Func, typename... Args>
-  // inline int run(const string name, Args &&...args) {
-  //   Func f = funcs[name]; assert(f);
-  //   return run(f, args...);
-  // }
-
-  // template <typename Func, typename... Args>
-  // inline int atomic(Func &&f, Args &&...args) {
-  //   voidfunction vf = bind(forward<Func>(f), forward<Args>(args)...);
-  //   u64 address = *(long *)(char *)&vf; // https://stackoverflow.com/a/44236212/9464885
-  //   // cout << address;
-  //   address = rehash((u64)address);
-  //   // cout << " " << address << "\n";
-  //   return workers[address % size()]->push(vf);
-  // }
-
 // ============================================================ TEST(WorkerPool)
-Atomic<int> test_rounds = 0;
+TEST(WorkerPool) {
+  atomic<int> events(0), most(0);
+  Elastic e;
+  e.min = 1, e.max = 4, e.idle = 0.02;
+  e.onresize = [&](int size, int was) {
+    events++;
+    for (int m = most; size > m && !most.compare_exchange_weak(m, size);) {}
+  };
+  WorkerPool p(8, e);
+  CHECK(p.threads() == 1 && events == 1);
 
-void test_ping2(int N) { 
-  if (N % 100'000 == 0){
-    log("ping ", N);
-    for (auto i = N-1; i >= N-100'000; i--)
-    workerPool().run(test_ping2, i);
-  }
-  // run(test_ping, N-1);
+  atomic<int> done(0);
+  for (int i = 0; i < 200; i++) p.run([&] { sleep(1); done++; }); // a burst
+  while (done < 200) sleep(1);
+  CHECK(most > 1 && most <= 4 && p.grown > 1);
 
-  test_rounds++;
-  if(N==0) workerPool().stop();
-}
+  for (int i = 0; i < 500 && p.threads() > 1; i++) sleep(1); // idle, back to min
+  CHECK(p.threads() == 1 && p.retired == p.grown - 1);
 
-TEST(WorkerPool) {
-  workerPool().run(test_ping, 1e6);
-  
-  workerPool().showstats = true;
-  workerPool().join();
-  
-  CHECK(test_rounds==1e6);
+  int before = events;
+  p.close();
+  p.join();
+  CHECK(p.threads() == 0 && events == before + 1 && p.drained());
 }
 
-}  // namespace uniq
\ No newline at end of file
+}// uniq • Released under GPL 3.0
@@ -1,7 +1,18 @@
 #include "uniq.h"
+namespace uniq { // every operator new, logged unless quiet
+atomic<u64> mallocs(0);
+bool mallocsQuiet = false;
+}
+
 void* operator new(size_t size)
 {
   void* r= malloc(size);
-  log("malloc(", size, ")", r);
+  uniq::mallocs.fetch_add(1, std::memory_order_relaxed);
+  static thread_local bool logging = false; // log() allocates too
+  if (!uniq::mallocsQuiet && !logging) {
+    logging = true;
+    uniq::log("malloc(", size, ")", r);
+    logging = false;
+  }
   return r;
-}
\ No newline at end of file
+}
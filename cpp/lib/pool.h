@@ -1,30 +1,76 @@
 #pragma once
+#include <sys/resource.h> // setpriority
 #include "uniq.h"
 namespace uniq {
 
 // ThreadPool =================================================================
 // #include "worker.h"
-struct ThreadPool : public Queue<voidfunction> {
+// Each worker owns a work stealing Deque: run() from inside a worker pushes
+// there (LIFO, cache hot) and idle workers steal the oldest from a random
+// peer. run() from outside goes through the shared priority lanes, the
+// injection queue, where run(URGENT, f) jumps ahead of the bulk work. Idle
+// workers spin a little, then park until there is work to take.
+enum Priority { URGENT, HIGH, NORMAL, LOW };
+
+// what run() does when the lane it pushes to is full: wait for room (a worker
+// helps with other tasks meanwhile, so fan-out can't deadlock), run the task
+// on the calling thread, drop it counting, or refuse it returning 0
+enum Saturation { BLOCK, CALLER_RUNS, DROP, REJECT };
+
+struct ThreadPool : public PriorityQueue<Task, LOW + 1, Adaptive> {
+  typedef PriorityQueue<Task, LOW + 1, Adaptive> Injection;
+
   vector<thread> workers;
+  vector<unique_ptr<Deque<Task*>>> deques; // one per worker, nodes from TaskMemory
+  struct alignas(CACHE_LINE) Count {
+    atomic<u64> n{0};
+    u64 spawned = 0; // by this worker, its own thread only
+    Turns turns;     // its lane picking state, see PriorityQueue
+  };
+  unique_ptr<Count[]> taken;                 // deque tasks each worker ran, the last for helpers
   // vector<uniq::Worker&> workers;
-  ThreadPool(int size = 0): Queue<voidfunction>(64) {
-    if (!size) size = thread::hardware_concurrency();
+
+  static inline thread_local ThreadPool* owner = nullptr; // the pool of this worker thread
+  static inline thread_local int self = -1;               // and its index
+
+  vector<int> cpus;      // where each worker is pinned, see Topology.h
+  Placement placement;
+  int nice; // of the worker threads, as nice(1). Below 0 needs privileges
+
+  Saturation saturation = BLOCK;
+  atomic<u64> dropped{0}, rejected{0}, inlined{0}; // by the saturation policy
+  static const u64 INLINE = ~0ULL; // run() ran the task itself, CALLER_RUNS
+  static const u64 SPAWNED = 1ULL << 63; // ids of spawn(): the bit, worker << 48, its count
+
+  // lane is the capacity of each priority lane of the injection queue
+  ThreadPool(int size = 0, Placement placement = UNPINNED, int lane = 64, int nice = 0)
+    : Injection(lane), placement(placement), nice(nice) {
+    if (!size) size = placement == CORES ? topology().cores : thread::hardware_concurrency();
+    if (placement != UNPINNED) cpus = topology().place(placement, size);
+    for (auto i = 0; i < size; i++) deques.push_back(make_unique<Deque<Task*>>());
+    taken.reset(new Count[size + 1]);
     for (auto i = 0; i < size; i++) {
       // workers.push_back(new Worker(this));
       workers.push_back(thread(&ThreadPool::worker, this, i + 1));
     };
   }
 
+  ~ThreadPool() { for (auto &d : deques) while (auto t = d->take()) release(t); }
+
   void join() { for (auto &w : workers) w.join(); }
 
   bool showstats = false;
 
   void worker(int id) {
     if(showstats) uniq::out("\n", colorcode(id), sstr("worker[", id, "] started"));
+    owner = this;
+    self = id - 1;
+    if (placement != UNPINNED) Topology::pin(cpus[self]); // when refused it runs anywhere
+    if (nice) setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice); // and at the usual priority
     int done = 0;
     Time t, total(0);
-    voidfunction f;
-    while (this->running() && pop(f)){
+    Task f;
+    while (this->running() && next(f)){
       t = CpuTime();
       f();
       total += t(CpuTime());
@@ -34,14 +80,110 @@ struct ThreadPool : public Queue<voidfunction> {
   };
 
   template <typename Func, typename... Args>
-  inline int run(Func &&f, Args &&...args) {
-    if(!this->running() && counter() < 0) 
+  inline u64 run(Func &&f, Args &&...args) {
+    return run(NORMAL, forward<Func>(f), forward<Args>(args)...);
+  }
+
+  template <typename Func, typename... Args>
+  inline u64 run(Priority p, Func &&f, Args &&...args) {
+    if(!this->running() && !counter()) 
       start();
-    // voidfunction vf = [this]()->void { f(args...); }
-    voidfunction vf = bind(forward<Func>(f), forward<Args>(args)...);
-    return push(vf);
+    if (!this->running() || this->closed()) return 0; // for workers too, so close() drains
+    Task task(forward<Func>(f), forward<Args>(args)...); // no malloc up to 48 bytes
+    if (owner == this && p == NORMAL) return spawn(move(task)); // from one of our tasks
+    for (;;) { // moved through the ring, captures are not copied. Kept when full
+      if (u64 id = pushAt(p, move(task), false)) return id;
+      if (!this->running() || this->closed()) return 0; // stopped or closed, not saturated
+      switch (saturation) {
+        case CALLER_RUNS: task(); inlined++; return INLINE;
+        case DROP: dropped++; return 0;
+        case REJECT: rejected++; return 0;
+        case BLOCK:
+          if (owner != this) return pushAt(p, move(task));
+          if (!help()) sleep(); // a worker makes room itself
+      }
+    }
+  }
+
+  // runs f(args...) and returns the Future of its result, see Future.h
+  template <typename Func, typename... Args>
+  auto async(Func &&f, Args &&...args);
+
+  // runs one queued task on the calling thread, false when there was none.
+  // Threads waiting for a result help with this instead of blocking.
+  bool help() {
+    Task f;
+    if (!find(f)) return false;
+    f();
+    return true;
+  }
+
+  // nothing queued where the calling thread's tasks go, so a peer may be
+  // starving: the cue for lazy splitting to hand out half of its work
+  bool hungry() { return owner == this ? deques[self]->empty() : Injection::empty(); }
+
+  bool empty() override { return Injection::empty() && idle(); }
+
+  u64 counter() { // tasks popped so far, injected and spawned
+    u64 r = Injection::counter();
+    for (size_t i = 0; i <= deques.size(); i++) r += taken[i].n.load(memory_order_relaxed);
+    return r;
+  }
+
+ protected:
+  // pushes into the calling worker's deque. The id counts per worker of this
+  // pool, with the worker in the high bits, apart from the injection's ids
+  u64 spawn(Task&& task) {
+    deques[self]->push(new (TaskMemory::get(sizeof(Task))) Task(move(task)));
+    this->notEmpty.notify(); // a parked peer may steal it
+    return SPAWNED | u64(self) << 48 | ++taken[self].spawned;
   }
 
+  static void release(Task* t) {
+    t->~Task();
+    TaskMemory::put(t, sizeof(Task));
+  }
+
+  bool idle() { // no deque holds work
+    for (auto &d : deques) if (!d->empty()) return false;
+    return true;
+  }
+
+  // the next task for this worker, waiting for one. false once stopped or drained
+  bool next(Task& f) {
+    for (;;) {
+      if (find(f)) return true;
+      if (!this->running() || (Injection::drained() && idle())) return false;
+      this->notEmpty.wait([&]{ return !empty() || !this->running() || Injection::drained(); });
+    }
+  }
+
+  // its own newest, else the oldest injected, else a random peer's oldest.
+  // Every 61 tasks the injection queue goes first, so outside work can't
+  // starve behind a busy local tree. Threads from outside only steal.
+  bool find(Task& f) {
+    static thread_local u32 tick = 0, r = 0;
+    int me = owner == this ? self : -1;
+    if (!r) r = 2654435761u * (me + 2); // xorshift state, never zero
+
+    auto inject = [&] { return me >= 0 ? Injection::pop(f, false, taken[me].turns) : Injection::pop(f, false); };
+    if (++tick % 61 == 0 && inject()) return true;
+    Task* t = me >= 0 ? deques[me]->take() : nullptr;
+    if (!t && inject()) return true;
+    for (size_t k = 0, n = deques.size(); !t && k < n; k++) {
+      r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+      size_t victim = r % n;
+      if (victim != size_t(me)) t = deques[victim]->steal();
+    }
+    if (!t) return false;
+    if (me >= 0) taken[me].n.store(taken[me].n.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    else taken[deques.size()].n.fetch_add(1, memory_order_relaxed);
+    f = move(*t);
+    release(t);
+    return true;
+  }
+
+ public:
   // int size() { return workers.size(); }
   // void sleep(int ms=0) {if (ms==0) sched_yield(); else this_thread::sleep_for(chrono::milliseconds(ms)); }
   // inline void wait(int id) { while(counter() < id) sleep(); }
@@ -87,10 +229,15 @@ inline ThreadPool& pool(int size=0) {
 
 // run ========================================================================
 template <typename Func, typename... Args>
-inline int run(Func&& f, Args&&... args) {
+inline u64 run(Func&& f, Args&&... args) {
   return pool().run(f, args...);
 }
 
+template <typename Func, typename... Args>
+inline u64 run(Priority p, Func&& f, Args&&... args) {
+  return pool().run(p, f, args...);
+}
+
 // tests =======================================================================
 Atomic<int> rounds = 0;
 void test_ping(int v);
@@ -103,5 +250,88 @@ TEST(Pool) {
   run(test_ping, 999); // start the flow
   pool().join();
   CHECK(rounds==1000);
+
+  ThreadPool p(1); // one worker, so the order is the pool's
+  vector<int> order;
+  p.run([&]{ sleep(20); }); // keeps the worker busy while we queue
+  for (int i = 0; i < 3; i++) p.run(LOW, [&, i]{ order.push_back(i); });
+  p.run(URGENT, [&]{ order.push_back(-1); });
+  p.run(LOW, [&]{ p.stop(); });
+  p.join();
+  CHECK(order.size() == 4 && order[0] == -1);
+
+  ThreadPool d(1); // close() runs what was queued, then lets the workers go
+  atomic<int> ran(0);
+  for (int i = 0; i < 50; i++) d.run(i % 4 ? NORMAL : LOW, [&]{ sleep(); ran++; });
+  d.close();
+  CHECK(!d.run([&]{ ran++; }));
+  d.join();
+  CHECK(ran == 50 && d.drained());
+
+  ThreadPool w(2); // tasks run() from a worker go to its deque, peers steal
+  atomic<int> leaves(0);
+  function<void(int)> tree = [&](int depth) {
+    if (!depth) { leaves++; return; }
+    w.run(tree, depth - 1);
+    w.run(tree, depth - 1);
+  };
+  w.run(tree, 10);
+  while (leaves < 1024) sleep();
+  w.close();
+  w.join();
+  CHECK(leaves == 1024 && w.counter() == 2047);
+
+  ThreadPool u(2); // job ids never repeat, spawned or injected, across workers
+  mutex m;
+  set<u64> ids;
+  atomic<int> made(0);
+  for (int i = 0; i < 20; i++) {
+    u64 id = u.run([&]{
+      for (int j = 0; j < 50; j++) { u64 k = u.run([]{}); lock_guard<mutex> hold(m); ids.insert(k); made++; }
+    });
+    lock_guard<mutex> hold(m);
+    ids.insert(id);
+  }
+  while (made < 1000) sleep(); // all spawned before close(), which refuses them
+  u.close();
+  u.join();
+  CHECK(ids.size() == 1020);
+
+  ThreadPool s(1); // saturation, with the worker stuck and the LOW lane full
+  atomic<bool> go(false);
+  atomic<int> done(0);
+  s.run([&]{ while (!go) sleep(); });
+  while (!s.Injection::empty()) sleep();
+  s.saturation = DROP;
+  int queued = 0;
+  for (int i = 0; i < 100; i++) queued += s.run(LOW, [&]{ done++; }) > 0;
+  CHECK(queued == 64 && s.dropped == 36);
+  s.saturation = REJECT;
+  CHECK(!s.run(LOW, [&]{ done++; }) && s.rejected == 1);
+  s.saturation = CALLER_RUNS;
+  CHECK(s.run(LOW, [&]{ done++; }) == ThreadPool::INLINE && done == 1);
+  go = true;
+  s.close();
+  s.join();
+  CHECK(done == 65);
+
+  ThreadPool z(1); // closed, a worker's own spawns are refused too
+  atomic<u64> spawned(1);
+  z.run([&]{ z.close(); spawned = z.run([]{}); });
+  z.join();
+  CHECK(spawned == 0 && z.drained());
+
+  ThreadPool x(1); // stopped is not saturated: nothing counted as dropped
+  x.saturation = DROP;
+  x.run([&]{ x.stop(); });
+  x.join();
+  CHECK(!x.run(LOW, [&]{ done++; }) && x.dropped == 0);
+
+  ThreadPool c(0, CORES); // a worker pinned on each physical core
+  atomic<int> cpu(-1);
+  c.run([&]{ cpu = sched_getcpu(); });
+  c.close();
+  c.join();
+  CHECK(int(c.workers.size()) == topology().cores && count(c.cpus.begin(), c.cpus.end(), cpu.load()));
 }
 }// uniq • Released under GPL 3.0
\ No newline at end of file
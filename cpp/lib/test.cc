@@ -1,5 +1,6 @@
 // Dependable tests, that cannot be with original code because dependencies 
 //==============================================================================
+#include <sys/wait.h> // waitpid, for the SharedQueue test
 namespace uniq {
 
 TEST(Queue){ // ========================================================== Queue
@@ -35,6 +36,174 @@ TEST(Queue){ // ========================================================== Queue
   // log("Queue:", double(CpuTime(t)));
 }
 
+TEST(QueueIds){ // ====================================================== QueueIds
+  Queue<int> q(2);
+  int v;
+  CHECK(q.push(10) == 1 && q.push(20) == 2);
+  CHECK(!q.push(30, false)); // full, nothing queued
+  CHECK(q.pop(v) == 1 && v == 10 && q.push(30) == 3);
+  CHECK(q.pop(v) == 2 && q.pop(v) == 3 && v == 30);
+  CHECK(q.counter() == 3 && !q.pop(v, false));
+}
+
+TEST(QueueBatch){ // ================================================ QueueBatch
+  Queue<int> q(8);
+  vector<int> a = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10}, rest;
+  int b[4];
+
+  CHECK(q.pushN(a.begin(), 6) == 6);
+  CHECK(q.popN(b, 4) == 4 && b[0] == 1 && b[3] == 4);
+  CHECK(q.pushN(a.begin() + 6, 4) == 4);
+  CHECK(q.popAll(rest) == 6 && rest.front() == 5 && rest.back() == 10);
+  CHECK(q.empty() && !q.popN(b, 4, false));
+
+  vector<thread> threads;
+  atomic<long> produced(0), consumed(0);
+  atomic<int> ends(0); // one popN may take both -1s, so the consumers count them together
+  for (int i = 0; i < 2; i++) {
+    threads.push_back(thread([&]{
+      int items[32];
+      for (int n = 0; n < 1000; n++) {
+        for (int j = 0; j < 32; j++) produced += items[j] = n * 32 + j;
+        q.pushN(items, 32);
+      }
+      q.push(-1);
+    }));
+    threads.push_back(thread([&]{
+      int items[32];
+      while (ends < 2) {
+        int n = q.popN(items, 32, false); // not waiting, the other may have ended us
+        if (!n) sleep();
+        for (int j = 0; j < n; j++)
+          if (items[j] == -1) ends++; else consumed += items[j];
+      }
+    }));
+  };
+  for (auto &t : threads) t.join();
+
+  CHECK(produced == consumed);
+}
+
+TEST(QueueStats){ // ================================================ QueueStats
+  Queue<int, MPMC, Yield, Tracked> q(4);
+  int v;
+  for (int i = 1; i <= 4; i++) q.push(i);
+  CHECK(!q.push(5, false)); // full
+  while (q.pop(v, false));  // drains, then finds it empty
+  QueueStats s = q.stats();
+  CHECK(s.fullWaits == 1 && s.emptyWaits == 1 && s.maxDepth == 4);
+  CHECK(s.pushes() == 4 && s.depth[1] == 1 && s.depth[2] == 2 && s.depth[3] == 1);
+
+  vector<thread> threads; // each thread counts on its own block
+  for (int t = 0; t < 3; t++)
+    threads.push_back(thread([&]{ for (int i = 0; i < 1000; i++) { q.push(i); q.pop(v); } }));
+  for (auto &t : threads) t.join();
+  CHECK(q.stats().pushes() == 3004);
+
+  Queue<int> plain; // untracked unless built with -DQUEUE_STATS
+  plain.push(1);
+  bool tracked = is_same<QueueTracking, Tracked>::value;
+  CHECK(plain.stats().pushes() == tracked);
+}
+
+template <typename Policy> long test_policy(int producers) {
+  Queue<int, Policy> q(16);
+  vector<thread> threads;
+  atomic<long> produced(0), consumed(0);
+
+  for (int i = 0; i < producers; i++)
+    threads.push_back(thread([&]{
+      for (int n = 1; n <= 10'000; n++) { q.push(n); produced += n; }
+      q.push(-1);
+    }));
+
+  int v;
+  for (int done = 0; done < producers && q.pop(v);)
+    if (v == -1) done++; else consumed += v;
+
+  for (auto &t : threads) t.join();
+  return produced - consumed;
+}
+
+TEST(QueuePolicy){ // ============================================== QueuePolicy
+  CHECK(test_policy<SPSC>(1) == 0);
+  CHECK(test_policy<MPSC>(4) == 0);
+  CHECK(test_policy<MPMC>(4) == 0);
+}
+
+struct test_Item { // move only, no default constructor
+  static inline int alive = 0;
+  unique_ptr<int> v;
+  test_Item(int i) : v(new int(i)) { alive++; }
+  test_Item(test_Item&& o) : v(move(o.v)) { alive++; }
+  test_Item& operator=(test_Item&& o) { v = move(o.v); return *this; }
+  ~test_Item() { alive--; }
+};
+
+TEST(QueueMove){ // ================================================== QueueMove
+  {
+    Queue<test_Item> q(4);
+    CHECK(q.emplace(1) && q.push(test_Item(2)));
+    CHECK(test_Item::alive == 2);
+
+    test_Item a(0);
+    CHECK(q.pop(a) && *a.v == 1 && test_Item::alive == 2);
+  } // the queue destroys the item left in it
+  CHECK(test_Item::alive == 0);
+
+  Queue<unique_ptr<int>> p(2);
+  unique_ptr<int> u(new int(7)), w;
+  CHECK(p.push(move(u)) && !u && p.pop(w) && *w == 7);
+}
+
+template <typename Policy> struct test_Closing : Queue<int, Policy, Park> {
+  int signals = 0;
+  test_Closing() : Queue<int, Policy, Park>(2) {}
+  void ondrained() override { signals++; }
+};
+
+TEST(QueueClose){ // ================================================= QueueClose
+  test_Closing<MPMC> q;
+  int v;
+  q.push(1); q.push(2);
+  thread blocked([&]{ q.push(3); }); // waits for room, close() wakes it
+  sleep(5);
+  q.close();
+  blocked.join();
+  CHECK(q.closed() && !q.push(4) && !q.drained() && q.size() == 2);
+  CHECK(q.pop(v) && v == 1 && q.pop(v) && v == 2); // drains what was queued
+  CHECK(!q.pop(v) && q.drained() && q.signals == 1 && !q.pop(v, false) && q.signals == 1);
+
+  test_Closing<SPSC> s;
+  thread waiting([&]{ CHECK(!s.pop(v)); }); // waits for items, close() ends it
+  sleep(5);
+  s.close();
+  waiting.join();
+  CHECK(!s.push(1) && s.drained() && s.signals == 1);
+  s.start(); // open again
+  CHECK(s.push(1) == 1 && s.pop(v) && v == 1);
+
+  OpenQueue<int> o;
+  o.push(1);
+  o.close();
+  CHECK(!o.push(2) && o.pop(v) && v == 1 && !o.pop(v) && o.drained());
+}
+
+TEST(StaticQueue){ // ============================================== StaticQueue
+  StaticQueue<int, 8> q; // no heap, the slots are in q
+  CHECK(sizeof(q) >= 8 * CACHE_LINE);
+  int v;
+  for (int i = 1; i <= 8; i++) q.push(i);
+  CHECK(q.full() && !q.push(9, false));
+  CHECK(q.pop(v) == 1 && v == 1 && q.size() == 7);
+
+  long sum = 0; // a consumer thread against a producer on the tiny ring
+  thread consumer([&]{ for (int n = 0; n < 10'007; n++) { q.pop(v); sum += v; } });
+  for (int i = 1; i <= 10'000; i++) q.push(i);
+  consumer.join();
+  CHECK(sum == 2 + 3 + 4 + 5 + 6 + 7 + 8 + 50'005'000L && q.empty());
+}
+
 TEST(OpenQueue){ // ================================================== OpenQueue
   OpenQueue<int> q(64);  
   vector<thread> threads;
@@ -65,6 +234,202 @@ TEST(OpenQueue){ // ================================================== OpenQueue
   CHECK(produced > 0);
   CHECK(produced == consumed);
   // log("OpenQueue:", double(t(CpuTime())));
+
+  OpenQueue<unique_ptr<int>> bounded(2); // many producers never pass maxsize
+  atomic<int> most(0);
+  vector<thread> racing;
+  for (int i = 0; i < 4; i++) racing.emplace_back([&] { for (int j = 0; j < 1000; j++) bounded.push(make_unique<int>(j)); });
+  unique_ptr<int> p;
+  for (int i = 0; i < 4000 && bounded.pop(p); i++) most = max(most.load(), bounded.size());
+  for (auto &t : racing) t.join();
+  CHECK(most <= 2 && bounded.empty());
+}
+
+TEST(PriorityQueue){ // ========================================== PriorityQueue
+  PriorityQueue<int, 3> q(8);
+  int v;
+  q.push(10); q.pushAt(2, 20); q.pushAt(0, 30); // middle, low, urgent
+  CHECK(q.size() == 3 && q.pop(v) && v == 30);
+  CHECK(q.pop(v) && v == 10 && q.pop(v) && v == 20 && !q.pop(v, false));
+
+  q.selection = WEIGHTED; // 4:2:1 turns per round
+  for (int i = 0; i < 7; i++) for (int l = 0; l < 3; l++) q.pushAt(l, l);
+  int served[3] = {};
+  for (int i = 0; i < 7; i++) { q.pop(v); served[v]++; }
+  CHECK(served[0] == 4 && served[1] == 2 && served[2] == 1);
+  while (q.pop(v, false));
+
+  q.selection = AGING; // the low lane gets a turn every maxAge pops
+  q.maxAge = 3;
+  for (int i = 0; i < 8; i++) q.pushAt(0, 0);
+  q.pushAt(2, 2);
+  int n = 0;
+  while (q.pop(v, false) && v == 0) n++;
+  CHECK(v == 2 && n == 3);
+
+  PriorityQueue<int, 3> a(8), b(8); // each queue has its own round
+  a.selection = b.selection = WEIGHTED;
+  for (int l = 0; l < 3; l++) for (int i = 0; i < 4; i++) a.pushAt(l, l), b.pushAt(l, l);
+  for (int i = 0; i < 4; i++) a.pop(v); // a's turns 0-3, all lane 0
+  CHECK(b.pop(v) && v == 0); // not lane 1, where a's round got to
+}
+
+TEST(SharedQueue){ // ============================================== SharedQueue
+  struct Point { int x, y; };
+  string name = sstr("uniq-test-", getpid());
+  SharedQueue<Point> a(name, 8), b(name); // two mappings, two addresses
+  SharedQueue<Point>::unlink(name);       // the mappings stay
+  Point p;
+  CHECK(a.push({1, 2}) == 1 && b.size() == 1);
+  CHECK(b.pop(p) == 1 && p.x == 1 && p.y == 2 && a.empty());
+
+  SharedQueue<int> q(16); // anonymous, inherited by the child
+  pid_t child = fork();
+  if (!child) {
+    for (int i = 1; i <= 10'000; i++) q.push(i);
+    _exit(0);
+  }
+  long sum = 0;
+  int v;
+  for (int i = 1; i <= 10'000; i++) if (q.pop(v)) sum += v;
+  waitpid(child, nullptr, 0);
+  CHECK(sum == 50'005'000 && q.counter() == 10'000);
+}
+
+TEST(Deque){ // ========================================================== Deque
+  Deque<int*> d(2); // grows as needed
+  int v[5] = {1, 2, 3, 4, 5};
+  for (auto &i : v) d.push(&i);
+  CHECK(d.size() == 5 && *d.take() == 5 && *d.steal() == 1); // owner LIFO, thieves FIFO
+  CHECK(*d.take() == 4 && *d.steal() == 2 && *d.take() == 3);
+  CHECK(d.empty() && !d.take() && !d.steal());
+
+  long stolen = 0, kept = 0;
+  for (int i = 0; i < 1000; i++) d.push(&v[i % 5]);
+  thread thief([&]{ while (int* p = d.steal()) stolen += *p; });
+  while (int* p = d.take()) kept += *p;
+  thief.join();
+  CHECK(stolen + kept == 3000);
+}
+
+TEST(Task){ // ============================================================= Task
+  int x = 0;
+  Task t([&](int n) { x += n; }, 2); // bound like bind, inline
+  t();
+  Task u(move(t));
+  u();
+  CHECK(x == 4 && !t && u && sizeof(Task) == 64);
+
+  array<int, 64> big{}; // too big for inline, goes to TaskMemory
+  big[63] = 5;
+  auto owned = make_unique<int>(3); // move only captures are fine
+  Task b([&x, big, p = move(owned)] { x += big[63] + *p; });
+  u = move(b);
+  u();
+  CHECK(x == 12 && !b);
+
+  void* block = TaskMemory::get(100); // freed blocks are reused, no malloc
+  TaskMemory::put(block, 100);
+  CHECK(TaskMemory::get(100) == block);
+  TaskMemory::put(block, 100);
+  void* large = TaskMemory::get(4000); // past the classes, still cache line aligned
+  CHECK(uintptr_t(block) % CACHE_LINE == 0 && uintptr_t(large) % CACHE_LINE == 0);
+  TaskMemory::put(large, 4000);
+}
+
+template <typename Waiting> bool test_wait() {
+  Waiting w;
+  atomic<bool> flag(false);
+  thread t([&]{ sleep(2); flag = true; w.notify(); });
+  w.wait([&]{ return flag.load(); });
+  t.join();
+  return flag && w.stats.waits == 1 && double(w.stats.total()) > 0;
+}
+
+TEST(ElasticQueue){ // ============================================ ElasticQueue
+  ElasticQueue<int, 4> q; // tiny segments, to cross many of them
+  int v;
+  for (int i = 1; i <= 100; i++) q.push(i); // never full
+  CHECK(q.size() == 100 && !q.full());
+  CHECK(q.pop(v) == 1 && v == 1 && q.size() == 99);
+  for (int i = 2; i <= 100; i++) if (q.pop(v) != u64(i)) break;
+  CHECK(v == 100 && q.empty() && !q.pop(v, false));
+
+  vector<thread> threads;
+  atomic<long> produced(0), consumed(0);
+  for (int i = 0; i < 2; i++) {
+    threads.push_back(thread([&]{
+      for (int n = 1; n <= 10'000; n++) { q.push(n); produced += n; }
+      q.push(-1);
+    }));
+    threads.push_back(thread([&]{
+      int v;
+      while (q.pop(v) && v != -1) consumed += v;
+    }));
+  }
+  for (auto &t : threads) t.join();
+
+  CHECK(produced == consumed);
+
+  ElasticQueue<int, 4> c; // close() refuses pushes, pops drain what was queued
+  for (int i = 1; i <= 10; i++) c.push(i);
+  c.close();
+  CHECK(c.closed() && !c.push(11) && !c.drained() && c.size() == 10);
+  int sum = 0;
+  while (c.pop(v)) sum += v; // ends once drained, without waiting
+  CHECK(sum == 55 && c.drained());
+
+  ElasticQueue<int, 4> r; // closed under load: what got in comes out
+  atomic<long> accepted(0), drained(0);
+  threads.clear();
+  for (int i = 0; i < 2; i++) {
+    threads.push_back(thread([&]{
+      for (int n = 1; n <= 10'000; n++) if (r.push(n)) accepted += n;
+    }));
+    threads.push_back(thread([&]{
+      int v;
+      while (r.pop(v)) drained += v;
+    }));
+  }
+  sleep(1);
+  r.close();
+  for (auto &t : threads) t.join();
+  CHECK(accepted == drained && r.drained());
+}
+
+TEST(Wait){ // ============================================================= Wait
+  CHECK(test_wait<Spin>());
+  CHECK(test_wait<Yield>());
+  CHECK(test_wait<Backoff>());
+  CHECK(test_wait<Park>());
+  CHECK(test_wait<Adaptive>());
+
+  Park p; p.wait([]{ return true; }); // ready at once costs no wait
+  CHECK(p.stats.waits == 0 && p.stats.park == 0);
+}
+
+TEST(Deadline){ // ==================================================== Deadline
+  Queue<int, MPMC, Park> q(2);
+  int v;
+  q.push(1); q.push(2);
+  Time t = CpuTime();
+  CHECK(!q.tryPushFor(3, 0.01) && CpuTime(t) >= 0.01); // full until the deadline
+  CHECK(q.notFull.stats.timeouts == 1 && q.running());
+  q.pop(v); q.pop(v);
+  CHECK(!q.tryPopFor(v, 0) && !q.tryPopUntil(v, CpuTime() + 0.001));
+  auto wall = chrono::steady_clock::now(); // CpuTime seconds are wall clock seconds
+  CHECK(!q.tryPopFor(v, 0.02));
+  double waited = chrono::duration<double>(chrono::steady_clock::now() - wall).count();
+  CHECK(waited >= 0.019 && waited < 0.1);
+
+  thread late([&]{ sleep(5); q.push(4); });
+  CHECK(q.tryPopFor(v, 1) && v == 4); // woken well before the deadline
+  late.join();
+
+  OpenQueue<int, Adaptive> o(1);
+  o.push(1);
+  CHECK(!o.tryPushFor(2, 0.001) && o.tryPopFor(v, 0.001) && v == 1);
+  CHECK(!o.tryPopFor(v, 0.001) && o.notEmpty.stats.timeouts == 1);
 }
 
 TEST(Log){ //=============================================================== Log
@@ -10,8 +10,15 @@
 #include "Time.h" // time primitive
 #include "Atomic.h" // basic atomic types
 #include "Actor.h" // common parent for active classes
+#include "Wait.h" // spin, yield, backoff, park ... wait strategies
+#include "QueueStats.h" // contention and occupancy counters
 #include "queue.h" // the queue
 #include "OpenQueue.h" // a locking queue with elastic storage
+#include "ElasticQueue.h" // a lock free unbounded queue of segments
+#include "PriorityQueue.h" // lock free lanes served by priority
+#include "SharedQueue.h" // a Queue in shared memory, across processes
+#include "Deque.h" // work stealing deque
+#include "Task.h" // move only function, no malloc when small
 #include "Log.h" // simple logger
 #include "test.h" // unit testing
 #include "test.cc" // dependable tests
@@ -21,11 +28,18 @@
 #include "Benchmark.h" // speed tests
 #include "Node.h" // parent/children node using shared_ptr
 
+#include "Topology.h" // cpus, cores, caches and nodes, for placement
 #include "Worker.h" // worker thread
 #include "pool.h" // thread pool
+#include "Future.h" // async() results, then() and get()
+#include "Cancellation.h" // tokens to stop tasks early
+#include "TaskGroup.h" // run a batch, wait for all of it
+#include "Parallel.h" // parallel_for, parallel_reduce
+#include "TaskGraph.h" // tasks that wait for others, rerunnable
+#include "Executor.h" // named pools: cpu, io, latency
 // #include "model.h" // UniQ classes mockup
 // #include "Lazy.h" // lazy call
-// #include "WorkerPool.h" // A Worker with helpers
+#include "WorkerPool.h" // elastic pool, grows and shrinks with the load
 // #include "Json.h" // Json primitive
 #include "BigDigit.h" // big digit 
 #include "BigNumber.h" // big number
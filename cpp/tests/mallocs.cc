@@ -0,0 +1,43 @@
+// mallocs per task: std::function + bind, as run() used to, against Task
+// counted with the operator new of newwatch.h. compile using ./build mallocs
+#include "uniq.h"
+#include "newwatch.h"
+using namespace uniq;
+
+const int N = 100'000;
+atomic<long> sum(0);
+
+void add(int v) { sum += v; }
+
+template <typename F> void count(const string& what, F f) {
+  u64 before = mallocs;
+  f();
+  printf("%-36s %.2f mallocs/task\n", what.c_str(), double(mallocs - before) / N);
+}
+
+int main() {
+  mallocsQuiet = true;
+  array<char, 128> big{};
+  Queue<voidfunction> qf(1024);
+  Queue<Task> qt(1024);
+  voidfunction vf;
+  Task t;
+
+  count("function, small capture", [&] { for (int i = 0; i < N; i++) { qf.push(bind(add, i)); qf.pop(vf); vf(); } });
+  count("Task, small capture", [&] { for (int i = 0; i < N; i++) { qt.push(Task(add, i)); qt.pop(t); t(); } });
+  count("function, 128 byte capture", [&] { for (int i = 0; i < N; i++) { qf.push([big, i] { add(big[0] + i); }); qf.pop(vf); vf(); } });
+  count("Task, 128 byte capture", [&] { for (int i = 0; i < N; i++) { qt.push(Task([big, i] { add(big[0] + i); })); qt.pop(t); t(); } });
+
+  ThreadPool p(2);
+  count("ThreadPool::run from outside", [&] { for (int i = 0; i < N; i++) p.run(add, 1); while (p.counter() < u64(N)) sleep(); });
+  function<void(int)> tree = [&](int depth) { if (depth) { p.run(tree, depth - 1); p.run(tree, depth - 1); } };
+  count("ThreadPool::run from a task (tree)", [&] { // ~N tasks, spawned to the deques
+    u64 before = p.counter();
+    p.run(tree, 16);
+    while (p.counter() < before + (2 << 16) - 1) sleep();
+  });
+  p.close();
+  p.join();
+  return 0;
+}
+//uniq • Released under GPL 3.0
@@ -54,6 +54,6 @@ int main(){
   for (auto &t : pool) t.join(); // Wait termination
 
   printf("\nChecksum: %ld (it must be zero)\n", total.value);
-  printf("\ntasks: %d\n", Q.counter());
+  printf("\ntasks: %llu\n", Q.counter());
   return 0; // quick_exit(0);
 }
\ No newline at end of file
@@ -21,7 +21,7 @@ void ping(int v) {
 
   if (v <= 0) {
     // log("\ntasks: ", pool().counter());
-    pool().stop();
+    pool().close(); // the pongs still queued run before the workers leave
   };
 }
 
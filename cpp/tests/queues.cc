@@ -0,0 +1,207 @@
+// queue scaling benchmark for uniQ Library
+// Sweeps implementations, producers x consumers, ring capacity, payload size
+// and wait strategy. Each point prints throughput and p50/p99/p999 handoff
+// latency (push to pop) as a CSV line, the whole run is saved as CSV & JSON.
+// compile using ./build.sh queues, see ./queues --help for the sweep options
+
+#include "uniq.h"
+namespace nutshell {
+#include "../../nutshell/queue.h" // the core of the algorithm, ints only
+}
+using namespace uniq;
+
+namespace classic {
+#include "../../benchmarks/queue.h" // the queue of benchmarks/main.cpp, ints only
+}
+
+// ==================================================================== sweep
+struct Options {
+  vector<string> impls = {"uniq", "open", "nutshell", "classic"};
+  vector<string> waits = {"yield", "park", "adaptive"}; // spin yield backoff park adaptive
+  vector<int> producers = {1, 2, 4}, consumers = {1, 2, 4};
+  vector<int> capacities = {1, 64, 1024, 65536};
+  vector<int> payloads = {8, 64}; // bytes: 8 16 64 256 1024, the int queues are always 4
+  long items = 20'000;            // per point
+  string out = "queues";          // out.csv & out.json
+};
+
+struct Result {
+  string impl, wait;
+  int payload, capacity, producers, consumers;
+  long items;
+  double seconds, throughput, p50, p99, p999; // items/s, latencies in ns
+};
+
+const u64 STAMP = 0x7fffffff; // stamps keep 31 bits, to fit the int queues
+
+template <int N> struct Payload { // N bytes, the stamp first
+  u64 stamp;
+  array<char, N - sizeof(u64)> pad;
+};
+
+// push(stamp) queues a stamp, 0 meaning stop. pop() returns one, 0 when stopped
+template <typename Push, typename Pop>
+Result measure(int producers, int consumers, long items, Push push, Pop pop) {
+  vector<vector<u32>> latency(consumers);
+  vector<thread> threads;
+  Time t = CpuTime();
+
+  for (int c = 0; c < consumers; c++)
+    threads.push_back(thread([&, c] {
+      auto& l = latency[c];
+      l.reserve(items / consumers * 2);
+      for (u64 s; (s = pop());) l.push_back((ticks() - s) & STAMP);
+    }));
+
+  vector<thread> pushers;
+  for (int p = 0; p < producers; p++)
+    pushers.push_back(thread([&, p] {
+      for (long i = p; i < items; i += producers) push(ticks() | 1);
+    }));
+
+  for (auto& p : pushers) p.join();
+  for (int c = 0; c < consumers; c++) push(0);
+  for (auto& c : threads) c.join();
+
+  Result r{};
+  r.producers = producers, r.consumers = consumers, r.items = items;
+  r.seconds = CpuTime(t);
+  r.throughput = items / r.seconds;
+
+  vector<u32> all;
+  for (auto& l : latency) all.insert(all.end(), l.begin(), l.end());
+  sort(all.begin(), all.end());
+  auto pct = [&](double p) { return all.empty() ? 0 : all[min<size_t>(all.size() * p, all.size() - 1)] * clockCycle() * GIGA; };
+  r.p50 = pct(0.50), r.p99 = pct(0.99), r.p999 = pct(0.999);
+  return r;
+}
+
+// calls f with a value of the strategy named w, false when there is none
+template <typename F> bool withWait(const string& w, F f) {
+  if (w == "spin") f(Spin());
+  else if (w == "yield") f(Yield());
+  else if (w == "backoff") f(Backoff());
+  else if (w == "park") f(Park());
+  else if (w == "adaptive") f(Adaptive());
+  else return false;
+  return true;
+}
+
+template <typename F> bool withPayload(int n, F f) {
+  if (n == 8) f(Payload<8>());
+  else if (n == 16) f(Payload<16>());
+  else if (n == 64) f(Payload<64>());
+  else if (n == 256) f(Payload<256>());
+  else if (n == 1024) f(Payload<1024>());
+  else return false;
+  return true;
+}
+
+// runs one point for each combination that applies to impl
+void sweep(const Options& o, const string& impl, int P, int C, int capacity, function<void(Result)> report) {
+  auto ints = [&](auto& q) { // the int queues stop on a negative
+    Result r = measure(P, C, o.items,
+      [&](u64 s) { q.push(s ? int(s & STAMP) | 1 : -1); },
+      [&]() -> u64 { int v = q.pop(); return v < 0 ? 0 : v; });
+    r.impl = impl, r.wait = "yield", r.payload = sizeof(int), r.capacity = capacity;
+    report(r);
+  };
+
+  if (impl == "nutshell") { nutshell::Queue q(capacity); ints(q); }
+  if (impl == "classic") { classic::Queue q(capacity); ints(q); }
+  if (impl != "uniq" && impl != "open") return;
+
+  for (auto& wait : o.waits)
+    for (int payload : o.payloads) {
+      bool known = withWait(wait, [&](auto w) {
+        withPayload(payload, [&](auto p) {
+          typedef decltype(w) W;
+          typedef decltype(p) Item;
+          auto run = [&](auto& q) {
+            Result r = measure(P, C, o.items,
+              [&](u64 s) { Item x; x.stamp = s; q.push(x); },
+              [&]() -> u64 { Item x; return q.pop(x) ? x.stamp : 0; });
+            r.impl = impl, r.wait = wait, r.payload = payload, r.capacity = capacity;
+            report(r);
+          };
+          if (impl == "uniq") { Queue<Item, MPMC, W> q(capacity); run(q); }
+          else { OpenQueue<Item, W> q(capacity); run(q); }
+        });
+      });
+      if (!known) cerr << "unknown wait strategy " << wait << "\n";
+    }
+}
+
+// ================================================================== output
+string csvHeader() { return "impl,wait,payload,capacity,producers,consumers,items,seconds,throughput,p50_ns,p99_ns,p999_ns"; }
+
+string csv(const Result& r) {
+  return sstr(r.impl, ",", r.wait, ",", r.payload, ",", r.capacity, ",", r.producers, ",", r.consumers, ",",
+              r.items, ",", r.seconds, ",", integer(r.throughput), ",", integer(r.p50), ",", integer(r.p99), ",", integer(r.p999));
+}
+
+string json(const Result& r) {
+  return sstr("{\"impl\":\"", r.impl, "\",\"wait\":\"", r.wait, "\",\"payload\":", r.payload,
+              ",\"capacity\":", r.capacity, ",\"producers\":", r.producers, ",\"consumers\":", r.consumers,
+              ",\"items\":", r.items, ",\"seconds\":", r.seconds, ",\"throughput\":", integer(r.throughput),
+              ",\"p50_ns\":", integer(r.p50), ",\"p99_ns\":", integer(r.p99), ",\"p999_ns\":", integer(r.p999), "}");
+}
+
+vector<int> numbers(const string& s) {
+  vector<int> r;
+  stringstream ss(s);
+  for (string n; getline(ss, n, ',');) r.push_back(stoi(n));
+  return r;
+}
+
+vector<string> words(const string& s) {
+  vector<string> r;
+  stringstream ss(s);
+  for (string w; getline(ss, w, ',');) r.push_back(w);
+  return r;
+}
+
+int main(int argc, char** argv) {
+  Options o;
+  bool usage = argc % 2 == 0; // a flag without its value
+  for (int i = 1; i + 1 < argc && !usage; i += 2) {
+    string k = argv[i], v = argv[i + 1];
+    if (k == "--impl") o.impls = words(v);
+    else if (k == "--wait") o.waits = words(v);
+    else if (k == "--producers") o.producers = numbers(v);
+    else if (k == "--consumers") o.consumers = numbers(v);
+    else if (k == "--capacity") o.capacities = numbers(v);
+    else if (k == "--payload") o.payloads = numbers(v);
+    else if (k == "--items") o.items = stol(v);
+    else if (k == "--out") o.out = v;
+    else usage = true;
+  }
+  if (usage) {
+    cerr << "usage: queues [--impl uniq,open,nutshell,classic] [--wait spin,yield,backoff,park,adaptive]\n"
+            "              [--producers 1,2,4] [--consumers 1,2,4] [--capacity 1,64,1024,65536]\n"
+            "              [--payload 8,16,64,256,1024] [--items 20000] [--out queues]\n";
+    return 1;
+  }
+
+  vector<Result> results;
+  cout << csvHeader() << "\n";
+  for (auto& impl : o.impls)
+    for (int capacity : o.capacities)
+      for (int P : o.producers)
+        for (int C : o.consumers)
+          sweep(o, impl, P, C, capacity, [&](Result r) {
+            cout << csv(r) << "\n" << flush;
+            results.push_back(r);
+          });
+
+  ofstream c(o.out + ".csv"), j(o.out + ".json");
+  c << csvHeader() << "\n";
+  j << "[\n";
+  for (size_t i = 0; i < results.size(); i++) {
+    c << csv(results[i]) << "\n";
+    j << "  " << json(results[i]) << (i + 1 < results.size() ? ",\n" : "\n");
+  }
+  j << "]\n";
+  return 0;
+}
+//uniq • Released under GPL 3.0
@@ -13,9 +13,10 @@ u64 firstDivisor0(u64 n) { // O(0.5 sqrt(n))
 }
 
 // spiral algorithm test fewer candidates. www.primesdemystified.com
-u64 spiral(u64 n, u64 min, u64 max) { // O(0.27 sqrt(n))
+u64 spiral(u64 n, u64 min, u64 max, const CancellationToken& stop = CancellationToken()) { // O(0.27 sqrt(n))
   // log("block: ",min," ",max);
-  for (u64 i = min; i <= max; i += 30) { // todo: use SIMD
+  for (u64 i = min, turn = 0; i <= max; i += 30, turn++) { // todo: use SIMD
+    if (!(turn & 4095) && stop.cancelled()) return n; // another block found one
     u64 j = i;
     // if (j >= 6000000) asm("int3");
     if (!(n % j)) return j;
@@ -41,25 +42,25 @@ u64 spiralDivisor(u64 n, u64 limit = 0) {
   return spiral(n, 7, limit);
 }
 
-/* paralel version using spiral, distribute work to cores using blocks
-and pushing each block into the queue until a worker find a divisor. */
+/* paralel version using spiral: after a first block, parallel_reduce splits
+the remaining wheel turns (30 numbers, 8 candidates each) among the workers.
+The first block finding a divisor cancels found: the blocks not started are
+skipped and the running ones see it within 4096 turns. */
 u64 paralelDivisor(u64 n) {
   u64 blockSize = 3e6;
-  atomic<u64> block(7);
 
   // try a first block, before go wild
-  u64 result = spiralDivisor(n, block += blockSize);
-
-  for (u64 b = block; (result == n) && b < sqrt(n); b += blockSize) {
-
-    run([&]{ // this lambda runs in a worker thread
-      u64 res = spiral(n, b, b + blockSize);
-      if (res < n) result = res;
-    });
-
-  }
-  // emit('prime',n);
-  return result;
+  u64 result = spiralDivisor(n, 7 + blockSize);
+  u64 limit = sqrt(n);
+  if (result < n || limit <= 7 + blockSize) return result;
+
+  CancellationSource found;
+  CancellationToken stop = found.token();
+  Range<u64> turns(blockSize / 30 + 1, (limit - 7) / 30 + 1); // turn k starts at 7 + 30k
+  return parallel_reduce(turns, n,
+    [&](Range<u64> r) { return spiral(n, 7 + 30 * r.begin, 7 + 30 * (r.end - 1), stop); }, // runs in a worker thread
+    [](u64 a, u64 b) { return min(a, b); },
+    [&](u64 d) { if (d < n) found.cancel(); return d < n; }, pool(), stop);
 }
 
 int main() {